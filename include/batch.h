@@ -0,0 +1,87 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_BATCH_H_
+#define INCLUDE_BATCH_H_
+
+#include <sudoku.h>
+#include <solution_cache.h>
+#include <cstdio>
+#include <functional>
+
+// Settings for batch mode. Budgets in 'params' apply to each puzzle, and
+// puzzle k (0-based) uses seed params.randomSeed + k. initialTemp and
+// stagesLength <= 0 take the same per-instance defaults as the single
+// instance mode (order * 100 and order^2). Lines are written in input order,
+// so a puzzle the annealing never solves would hold back every later line:
+// with neither maxSeconds nor maxProposals set, each puzzle gets
+// kBatchProposalsPerN4 * n^4 proposals, and is reported as "best" past them.
+static const long long kBatchProposalsPerN4 = 100;
+
+struct BatchOptions {
+  SAParams      params;
+  int           threads;        // worker threads (<= 0: one per core)
+  bool          presolve;       // run Sudoku::presolve() first
+  SolutionCache* cache;         // looked up before solving and filled with
+                                // the solutions found (NULL: no cache)
+  bool          lockstep;       // anneal order 3 puzzles kLockstepLanes at
+                                // a time (see lockstep.h), unless params
+                                // use settings it doesn't have
+};
+
+// Totals of a batch run.
+struct BatchSummary {
+  long    puzzles;    // instances read
+  long    solved;     // reached cost 0
+  long    cached;     // of which taken from the cache
+  long    failed;     // stopped above cost 0 (budget ran out)
+  long    invalid;    // not solvable, or unreadable
+  double  seconds;    // wall-clock seconds for the whole batch
+};
+
+// Solves every instance found in 'in' (concatenated instances in the usual
+// text format) on a pool of worker threads. One line per instance is written
+// to 'out', in input order, as soon as it and all the previous ones are done:
+//   <index> <status> <initial cost> <final cost> <seconds> <n^2 cell values>
+// where status is "solved", "best" (budget ran out: best board found),
+// "invalid" or "error" (unreadable; the batch stops there, as the stream
+// position is lost). Cell values are listed row-major, -1 for cells left
+// empty. Puzzles solved from the cache have initial cost -1.
+void solveBatch(FILE* in, FILE* out, const BatchOptions& options,
+    BatchSummary* summary);
+
+// Where solveBatch() takes the instances from: each call loads the next one
+// into the given Sudoku and returns what loadInstance() would (1, 0 or -1),
+// or kEndOfInput when there are no more.
+typedef std::function<int(Sudoku*)> InstanceSource;
+static const int kEndOfInput = -2;
+
+// Same, for any source (e.g. a mapped text file or a binary corpus, see
+// instance_io.h).
+void solveBatch(const InstanceSource& next, FILE* out,
+    const BatchOptions& options, BatchSummary* summary);
+
+#endif  // INCLUDE_BATCH_H_
@@ -0,0 +1,60 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_BITBOARD_H_
+#define INCLUDE_BITBOARD_H_
+
+#include <sudoku.h>
+#include <stdint.h>
+
+// Full-board checks with one bitmask of values per row, column and square
+// (bit v-1 set if v shows up in it). With n = order^2, a unit that holds n
+// cells but only popcount(mask) distinct values has n - popcount(mask)
+// repeated ones, which is how the annealing cost counts them.
+// Boards up to n = 64 use an AVX2 path when the CPU has it (checked at
+// runtime); the scalar path handles every order.
+
+// Repeated values per kind of unit.
+struct BoardConflicts {
+  int rows;
+  int cols;
+  int squares;
+};
+
+// uint64_t words of scratch the functions below need for a board of 'order'.
+int bitboardScratchSize(int order);
+
+// Counts the repeated values of a full board. Returns false if some cell is
+// outside [1, n] (e.g. still empty).
+bool countConflicts(const TCell* board, int order, uint64_t* scratch,
+    BoardConflicts* out);
+
+// Looks for a value repeated among the filled cells (empty cells are 0).
+// Returns the index (i*n + j) of the first cell that repeats a value already
+// seen in its row, column or square, or -1 if there is none.
+int findRepeatedValue(const TCell* board, int order, uint64_t* scratch);
+
+#endif  // INCLUDE_BITBOARD_H_
@@ -0,0 +1,99 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_CHECKPOINT_H_
+#define INCLUDE_CHECKPOINT_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checkpoints of Sudoku::solve(). At the end of a temperature stage, once
+// the writer says one is due, solve() serializes its whole state into a
+// buffer (a few bytes per free cell) and hands it over; a background thread
+// writes it, so the search never waits for the disk. Sudoku::loadCheckpoint()
+// takes one back and the next solve() carries on from that stage exactly as
+// the original run would have.
+//
+// File (native byte order), all written by Sudoku::saveCheckpoint():
+//   "SUDOKUK2" (8 bytes), int32 order, uint64 hash of the givens
+//   the SAParams of the run, field by field
+//   the state of solve(): temperature, initial and best-stage temperature,
+//     best cost, run's best cost, stall count, reheats in a row, stages
+//     since the last reheat, alpha, stage length, stage, rejection-free
+//     flags, initial cost, proposals, accepted, reheats, seconds
+//   int32 words, then the random engine's state (uint64 each)
+//   int32 free cells, then their values in the board and in the best board
+//     (uint16 each, in the order of the free cell index)
+//   int64 proposals since the conflict set was rebuilt, int32 size, then the
+//     conflicting cells (int32 each)
+// Files are replaced atomically (written aside, then renamed), so a crash
+// while writing leaves the previous checkpoint in place.
+class CheckpointWriter {
+  public:
+    CheckpointWriter();
+    ~CheckpointWriter();   // close()
+
+    // Checkpoints go to 'filename', one every 'everySeconds' of search.
+    // Returns false if the file can't be created.
+    bool open(const char* filename, double everySeconds);
+    // Writes what's pending and stops the writer thread.
+    void close();
+    bool isOpen() const { return _thread.joinable(); }
+
+    // True if a checkpoint is due, 'seconds' into the search.
+    bool due(double seconds) const;
+    // Queues 'snapshot' for writing, taken 'seconds' into the search,
+    // replacing any older one not written yet. Swaps buffers with it, so the
+    // caller gets an old one back to reuse.
+    void submit(std::vector<uint8_t>* snapshot, double seconds);
+
+    long written() const;   // checkpoints written so far
+    bool failed() const;    // some write failed
+
+  private:
+    void writerLoop();
+
+    std::string _filename;
+    double _everySeconds;
+    double _lastSeconds;              // when the last snapshot was taken
+    std::thread _thread;
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;    // signaled on submit and close
+    std::vector<uint8_t> _pending;
+    bool _hasPending;
+    bool _closing;
+    long _written;
+    bool _failed;
+};
+
+// Reads a whole checkpoint file. Returns false if it can't be read.
+bool readCheckpoint(const char* filename, std::vector<uint8_t>* data);
+
+#endif  // INCLUDE_CHECKPOINT_H_
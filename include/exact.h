@@ -0,0 +1,99 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_EXACT_H_
+#define INCLUDE_EXACT_H_
+
+#include <sudoku.h>
+
+// Exact (complete) engine: depth-first search over the free cells with one
+// bitmask of used values per row, column and square, always branching on
+// the cell with the fewest candidates (MRV). Boards up to n = 64 (order 8).
+
+// Time limit of the exact and hybrid engines when the caller sets no budget:
+// on a large, loosely constrained board the search may not end in any
+// useful time.
+const double kExactDefaultSeconds = 60;
+
+enum ExactStatus {
+  kExactSolved,         // found a solution
+  kExactNoSolution,     // searched everything: there is none
+  kExactOutOfBudget,    // maxNodes or maxSeconds ran out
+  kExactUnsupported     // order above 8
+};
+
+struct ExactResult {
+  ExactStatus   status;
+  long long     nodes;      // values tried
+  double        seconds;    // wall-clock seconds
+};
+
+// Searches a solution for the givens of 'instance' (as loaded or presolved).
+// If 'hint' isn't NULL, each cell tries the value it has in 'hint' first, so
+// a good board (e.g. a low cost annealing one) leads the search. A solution
+// is copied into 'instance'. Budgets <= 0 mean no limit.
+ExactStatus solveExact(Sudoku* instance, const TCell* hint,
+    long long maxNodes, double maxSeconds, ExactResult* result);
+
+// Counts the solutions of the givens of 'instance', stopping at 'limit'
+// (2 tells unique from not). Returns -1 if maxNodes (if > 0) ran out first
+// or the order is above 8.
+int countSolutions(const Sudoku& instance, int limit, long long maxNodes);
+
+// When the hybrid engine hands off to the exact one.
+struct HybridParams {
+  int           handoffCost;    // annealing stops once its cost gets here
+  int           freeCells;      // start exact if presolve left at most these
+  double        sliceSeconds;   // ... or once it has run this long
+  long long     exactNodes;     // budget of the first exact attempt
+
+  HybridParams() : handoffCost(0), freeCells(0), sliceSeconds(0.25),
+    exactNodes(1000000) {}
+};
+
+struct HybridResult {
+  SAStatus      status;           // kSolved or why the annealing stopped
+  int           initialSolution;  // cost of the first annealing board
+  int           finalSolution;    // final cost (0 if solved)
+  int           handoffs;         // exact attempts
+  bool          solvedByExact;
+  bool          unsolvable;       // the exact engine proved it
+  long long     proposals;        // annealing proposals, all rounds
+  long long     nodes;            // exact nodes, all attempts
+  double        seconds;          // wall-clock seconds
+};
+
+// Annealing and exact search together. If presolve left few free cells, the
+// exact engine goes first. Otherwise the annealing runs until its cost drops
+// to handoffCost or its time slice ends, and the exact engine then searches
+// with the annealing board as hint. Each exact attempt that runs out of
+// nodes goes back to annealing (with the next seed), with twice the slice and
+// the nodes of the round before. Budgets in 'params' cover the whole run.
+// Orders above 8 only anneal.
+bool solveHybrid(Sudoku* instance, const SAParams& params,
+    const HybridParams& hybrid, HybridResult* result);
+
+#endif  // INCLUDE_EXACT_H_
@@ -0,0 +1,146 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_INSTANCE_IO_H_
+#define INCLUDE_INSTANCE_IO_H_
+
+#include <sudoku.h>
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file, memory-mapped when possible (and read into
+// memory otherwise, e.g. for pipes).
+class MappedFile {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    // Returns false if the file can't be opened or read.
+    bool open(const char* filename);
+    void close();
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+  private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char*       _data;
+    size_t            _size;
+    bool              _mapped;    // _data comes from mmap (else _buffer)
+    std::vector<char> _buffer;
+};
+
+// Next integer of a text buffer, skipping whitespace. Advances *cursor past
+// it. Returns false at the end of the buffer or on anything else than an
+// optionally negative number.
+inline bool parseInt(const char** cursor, const char* end, int* value) {
+  const char* p = *cursor;
+  bool negative = false;
+  int v = 0;
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+  if (p < end && *p == '-') {
+    negative = true;
+    ++p;
+  }
+  if (p == end || *p < '0' || *p > '9') return false;
+  for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+    if (v < 100000000) v = v*10 + (*p - '0');
+  }
+  *cursor = p;
+  *value = negative ? -v : v;
+  return true;
+}
+
+// Binary corpus: many instances in one file, readable in place from a
+// mapping. All fields are little-endian (native on the machines we run on).
+//   header  : CorpusHeader (32 bytes)
+//   records : one per instance, each starting at an 8-byte boundary:
+//             uint16 order, uint16 bytes per cell (1 if n < 256, else 2),
+//             uint32 reserved, then the n^2 givens row-major (0 = empty),
+//             zero-padded to a multiple of 8 bytes
+//   index   : uint64 byte offset of each record, at header.indexOffset
+struct CorpusHeader {
+  char      magic[8];       // "SUDOKUC1"
+  uint32_t  count;          // instances in the file
+  uint32_t  reserved;
+  uint64_t  indexOffset;
+  uint64_t  reserved2;
+};
+
+// Instances of a binary corpus, straight from the mapped file.
+class Corpus {
+  public:
+    // True if the buffer starts like a binary corpus.
+    static bool isCorpus(const char* data, size_t size);
+
+    // Checks the header and the index. Returns false on anything malformed.
+    // 'file' must stay open while the corpus is used.
+    bool open(const MappedFile& file);
+    long size() const { return _count; }
+    // Loads instance k into 's' (same return values as loadInstance).
+    int load(long k, Sudoku* s, bool checkValidity = true) const;
+
+  private:
+    const char*     _data;
+    size_t          _size;
+    long            _count;
+    const uint64_t* _index;
+};
+
+// Writes a binary corpus. The header gets its final values on close().
+class CorpusWriter {
+  public:
+    CorpusWriter();
+    ~CorpusWriter();
+
+    // Returns false if the file can't be created. It must be seekable.
+    bool open(const char* filename);
+    // Appends an instance: 'givens' holds n^2 cells, 0 for the empty ones.
+    bool add(int order, const TCell* givens);
+    // Writes the index and the header. Returns false on write errors.
+    bool close();
+
+  private:
+    FILE*                 _file;
+    uint64_t              _offset;    // where the next record goes
+    std::vector<uint64_t> _index;
+    std::vector<uint8_t>  _record;    // reused record buffer
+    bool                  _ok;
+};
+
+// Instance files of a directory named like the corpus in etc/
+// ("<order>_<fill%>"), sorted by name. Empty if it can't be read.
+std::vector<std::string> corpusFiles(const char* dir);
+
+// Order and fill percentage from a corpus file name (any leading directories
+// are skipped). Returns false if it isn't named like one.
+bool parseCorpusName(const std::string& filename, int* order, int* fill);
+
+#endif  // INCLUDE_INSTANCE_IO_H_
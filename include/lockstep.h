@@ -0,0 +1,78 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_LOCKSTEP_H_
+#define INCLUDE_LOCKSTEP_H_
+
+#include <sudoku.h>
+#include <functional>
+
+// Lockstep annealing of order 3 puzzles. Small boards spend much of their
+// solve() time outside the inner loop (loading, setting up the search), and
+// a single 9x9 board can't keep a core busy anyway, so this engine anneals
+// kLockstepLanes puzzles at once, one per 32 bits lane: the boards, the
+// occurrence tables, the moves and the random engines are laid out lane by
+// lane (struct of arrays), and each step makes one proposal in every lane,
+// with the move, its delta and the acceptance test computed for all lanes
+// together. CPUs with AVX2 (checked at runtime) do that with gathers; the
+// scalar path computes the very same numbers, so results don't depend on it.
+// A lane whose puzzle is done takes the next one from the source at the end
+// of the current temperature stage.
+//
+// Each lane runs the schedule of Sudoku::solve() (the same StageSchedule,
+// so cooling and stall handling match) with the fixed settings of SAParams
+// (initialTemp, alpha, stagesLength, stallStages, restart and the budgets,
+// all per puzzle); moves are drawn uniformly among all the pairs of free
+// cells that share a square. adaptive, moves, rejectionFree and targetCost
+// don't apply.
+
+static const int kLockstepLanes = 8;
+
+// A puzzle for a lane.
+struct LockstepJob {
+  Sudoku*       sudoku;   // order 3, loaded (and maybe presolved)
+  unsigned int  seed;
+  long          id;       // the caller's, handed back with the result
+};
+
+// Gives the next puzzle, or returns false if there is none right now. 'idle'
+// is true when no lane is busy, in which case returning false ends
+// solveLockstep().
+typedef std::function<bool(bool idle, LockstepJob* job)> LockstepSource;
+// Takes a finished puzzle, whose board is the best one found. cpuSeconds
+// isn't measured (the lanes share a thread).
+typedef std::function<void(const LockstepJob& job, const SAResult& result)>
+  LockstepSink;
+
+// Anneals the puzzles from 'next' until it runs dry, on the calling thread.
+// initialTemp and stagesLength must be > 0.
+void solveLockstep(const SAParams& params, const LockstepSource& next,
+    const LockstepSink& done);
+
+// True if solveLockstep() takes the AVX2 path on this CPU.
+bool lockstepUsesAvx2();
+
+#endif  // INCLUDE_LOCKSTEP_H_
@@ -0,0 +1,52 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_PORTFOLIO_H_
+#define INCLUDE_PORTFOLIO_H_
+
+#include <sudoku.h>
+
+// Outcome of a portfolio run.
+struct PortfolioResult {
+  int           winner;           // index of the run whose board was kept
+  unsigned int  seed;             // its random seed
+  SAStatus      status;           // how it ended
+  int           initialSolution;  // its initial cost
+  int           finalSolution;    // its final cost (0 if solved)
+  double        seconds;          // wall-clock seconds for the whole race
+  long long     proposals;        // moves proposed, summing every run
+};
+
+// Races 'runs' independent annealers on copies of 'instance', with seeds
+// params.randomSeed, params.randomSeed+1, ..., on 'threads' worker threads.
+// Budgets in 'params' apply to each run. As soon as one reaches cost 0, the
+// others are told to stop. The board of the winner (or, if none solves it,
+// the lowest cost one) is copied back into 'instance'.
+// Returns true if some run solved the instance.
+bool solvePortfolio(Sudoku* instance, int runs, int threads,
+    const SAParams& params, PortfolioResult* result);
+
+#endif  // INCLUDE_PORTFOLIO_H_
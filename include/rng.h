@@ -0,0 +1,132 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_RNG_H_
+#define INCLUDE_RNG_H_
+
+#include <stdint.h>
+
+// Small random engines owned by each solver, so that two solvers never share
+// state and a seed gives the same run on every platform (unlike rand()).
+// Every engine has the same interface:
+//   seed(s)      : resets the state from a 64 bits seed;
+//   next()       : 32 uniformly distributed bits;
+//   below(bound) : integer in [0, bound), bound > 0;
+//   getState(w), setState(w) : the state as kStateWords 64 bits words (e.g.
+//                  for a checkpoint; setState must get a state from getState).
+// Pick the one used by the solver with RandomEngine below.
+
+// SplitMix64. Only used to expand seeds into the state of other engines.
+class SplitMix64 {
+  public:
+    explicit SplitMix64(uint64_t seed) : _state(seed) {}
+    uint64_t next64() {
+      uint64_t z = (_state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+  private:
+    uint64_t _state;
+};
+
+// xoshiro256** (Blackman & Vigna, 2018).
+class Xoshiro256 {
+  public:
+    static const int kStateWords = 4;
+    explicit Xoshiro256(uint64_t s = 24) { seed(s); }
+    void seed(uint64_t s) {
+      SplitMix64 sm(s);
+      for (int k = 0; k < 4; ++k) _s[k] = sm.next64();
+    }
+    uint64_t next64() {
+      const uint64_t result = rotl(_s[1] * 5, 7) * 9;
+      const uint64_t t = _s[1] << 17;
+      _s[2] ^= _s[0];
+      _s[3] ^= _s[1];
+      _s[1] ^= _s[2];
+      _s[0] ^= _s[3];
+      _s[2] ^= t;
+      _s[3] = rotl(_s[3], 45);
+      return result;
+    }
+    uint32_t next() { return static_cast<uint32_t>(next64() >> 32); }
+    // Lemire's multiply-shift: no division, bias below 2^-32 * bound.
+    uint32_t below(uint32_t bound) {
+      return static_cast<uint32_t>((static_cast<uint64_t>(next()) * bound) >> 32);
+    }
+    void getState(uint64_t* w) const {
+      for (int k = 0; k < kStateWords; ++k) w[k] = _s[k];
+    }
+    void setState(const uint64_t* w) {
+      for (int k = 0; k < kStateWords; ++k) _s[k] = w[k];
+    }
+  private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    uint64_t _s[4];
+};
+
+// PCG32 (XSH-RR variant, O'Neill 2014).
+class Pcg32 {
+  public:
+    static const int kStateWords = 2;
+    explicit Pcg32(uint64_t s = 24) { seed(s); }
+    void seed(uint64_t s) {
+      SplitMix64 sm(s);
+      _state = sm.next64();
+      _inc = sm.next64() | 1;
+    }
+    uint32_t next() {
+      uint64_t old = _state;
+      _state = old * 6364136223846793005ULL + _inc;
+      uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+      uint32_t rot = static_cast<uint32_t>(old >> 59);
+      return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+    uint32_t below(uint32_t bound) {
+      return static_cast<uint32_t>((static_cast<uint64_t>(next()) * bound) >> 32);
+    }
+    void getState(uint64_t* w) const {
+      w[0] = _state;
+      w[1] = _inc;
+    }
+    void setState(const uint64_t* w) {
+      _state = w[0];
+      _inc = w[1];
+    }
+  private:
+    uint64_t _state;
+    uint64_t _inc;
+};
+
+// Engine used by the solver. Build with -DSUDOKU_RNG_PCG32 to switch.
+#ifdef SUDOKU_RNG_PCG32
+typedef Pcg32 RandomEngine;
+#else
+typedef Xoshiro256 RandomEngine;
+#endif
+
+#endif  // INCLUDE_RNG_H_
@@ -0,0 +1,165 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_SERVER_H_
+#define INCLUDE_SERVER_H_
+
+#include <sudoku.h>
+#include <solution_cache.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Long-running solve server: reads requests from any number of connections
+// (streams), queues them and solves them on a fixed pool of workers.
+//
+// Requests, one per line (the instance follows in the usual text format and
+// may span lines):
+//   solve <id> [deadline=<s>] [seed=<n>] <instance>
+//   cancel <id>
+//   stats
+//   quit            (ends the connection once its requests are answered)
+//   shutdown        (cancels everything and stops the server)
+// Replies, one line each, in completion order:
+//   queued <id> <queue depth>
+//   result <id> <status> <final cost> <wait ms> <solve ms> [<n^2 values>]
+//     status: solved, best (deadline or budget hit: best board found),
+//     cancelled, expired (deadline passed while queued) or invalid; values
+//     (row-major) only for solved and best
+//   cancelling <id>
+//   stats queued=<n> running=<n> received=<n> solved=<n> best=<n>
+//     cancelled=<n> expired=<n> invalid=<n> p50_ms=<x> p90_ms=<x> p99_ms=<x>
+//     (latencies from arrival to reply, over the last kLatencyWindow replies)
+//   error <id or -> <message>
+// Ids are chosen by the client and must be unique among the requests still
+// queued or running.
+
+// Settings of the server. As in batch mode, params.initialTemp and
+// stagesLength <= 0 take the per-instance defaults; budgets in params apply
+// to each request, on top of its deadline.
+struct ServerOptions {
+  SAParams        params;
+  int             workers;          // solving threads (<= 0: one per core)
+  bool            presolve;
+  double          deadline;         // default deadline in seconds (0: none)
+  size_t          maxQueue;         // requests waiting beyond this are refused
+  SolutionCache*  cache;            // NULL: no cache
+};
+
+// Counters of the server so far.
+struct ServerStats {
+  long    queued;       // waiting right now
+  long    running;      // being solved right now
+  long    received;     // solve requests accepted in the queue
+  long    solved;
+  long    best;
+  long    cancelled;
+  long    expired;
+  long    invalid;      // unreadable or unsolvable instances
+  double  p50, p90, p99;  // reply latency, in milliseconds
+};
+
+class SolveServer {
+  public:
+    typedef std::function<void(const std::string&)> Reply;
+    static const int kLatencyWindow = 4096;
+
+    explicit SolveServer(const ServerOptions& options);
+    // Cancels whatever is left and joins the workers.
+    ~SolveServer();
+
+    // Serves one connection: reads requests from 'in' until EOF, quit or
+    // shutdown, answering through 'reply' (called from several threads, one
+    // line at a time, with the newline). Returns once every request of the
+    // connection was answered. Returns false if shutdown was asked.
+    bool serve(FILE* in, const Reply& reply);
+
+    // Cancels every request and makes serve() calls return at their next
+    // request.
+    void shutdown();
+    bool stopping() const { return _stopping.load(); }
+
+    ServerStats stats();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Answers of one connection, and how many of its requests are pending.
+    struct Session {
+      Reply                   reply;
+      std::mutex              mutex;
+      std::condition_variable done;
+      int                     pending;
+    };
+
+    struct Request {
+      std::string               id;
+      Sudoku                    sudoku;
+      unsigned int              seed;
+      Clock::time_point         arrival;
+      Clock::time_point         started;    // taken by a worker
+      Clock::time_point         deadline;
+      bool                      hasDeadline;
+      bool                      running;
+      std::atomic<bool>         stop;
+      std::shared_ptr<Session>  session;
+    };
+
+    SolveServer(const SolveServer&);
+    SolveServer& operator=(const SolveServer&);
+
+    void handleSolve(const std::string& line, FILE* in,
+        const std::shared_ptr<Session>& session);
+    void handleCancel(const std::string& id, Session* session);
+    void workerLoop();
+    void solve(Request* request);
+    // Sends the result line of a request, updates the counters and releases
+    // it.
+    void finish(Request* request, const char* status, double solveMs);
+
+    ServerOptions                   _options;
+    std::vector<std::thread>        _workers;
+    std::mutex                      _mutex;
+    std::condition_variable         _hasWork;
+    std::deque<Request*>            _queue;
+    std::map<std::string, Request*> _active;      // queued or running, by id
+    std::atomic<bool>               _stopping;
+    long                            _sequence;    // default seeds
+    ServerStats                     _stats;
+    std::vector<double>             _latencies;   // ring of the last replies
+    size_t                          _latencyNext;
+};
+
+#endif  // INCLUDE_SERVER_H_
@@ -0,0 +1,109 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_SOLUTION_CACHE_H_
+#define INCLUDE_SOLUTION_CACHE_H_
+
+#include <sudoku.h>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Canonical form of a set of givens under the symmetries of Sudoku: value
+// relabeling, permutation of the rows within a band and of the bands (same
+// for columns and stacks) and transposition. Equivalent puzzles get the same
+// canonical givens, so a solution stored under them serves all of them.
+//
+// The form is the lexicographically smallest relabeled grid over a set of
+// candidate transforms that only depends on the puzzle up to symmetry: rows
+// and columns are ordered by colors refined from the givens, and the
+// permutations of lines with equal colors are all tried. When there are too
+// many (very symmetric or nearly empty puzzles) ties are broken by position
+// instead: the form is still a valid transform, but equivalent puzzles may
+// then miss each other in the cache.
+struct CanonicalForm {
+  int                 order;
+  TBoard              givens;       // canonical givens, row-major
+  bool                transposed;   // the original is transposed first
+  std::vector<int>    rows;         // canonical row r is original row rows[r]
+  std::vector<int>    cols;         // same for columns
+  std::vector<TCell>  labels;       // canonical value of each original value
+
+  // Maps a full board between the original and the canonical coordinates.
+  void toCanonical(const TBoard& original, TBoard* canonical) const;
+  void toOriginal(const TBoard& canonical, TBoard* original) const;
+};
+
+// Computes the canonical form of 'givens' (order^4 cells, 0 for the empty
+// ones).
+void canonicalize(int order, const TBoard& givens, CanonicalForm* form);
+
+// Solutions by canonical givens, least recently used first out. Optionally
+// backed by a file, so solutions survive the process. Thread safe.
+class SolutionCache {
+  public:
+    explicit SolutionCache(size_t capacity);
+    ~SolutionCache();
+
+    // Loads the entries of a cache file (the last ones, if it has more than
+    // the capacity) and appends every new entry to it. The file is created
+    // if it doesn't exist. Returns false if it can't be opened or isn't a
+    // cache file.
+    bool open(const char* filename);
+
+    // If a puzzle with the same canonical form was stored, writes its
+    // solution, mapped back to the original coordinates, and returns true.
+    bool lookup(const CanonicalForm& form, TBoard* solution);
+    // Stores the (full, verified) solution of the puzzle of 'form'.
+    void store(const CanonicalForm& form, const TBoard& solution);
+
+    size_t size();
+    long hits();
+    long misses();
+
+  private:
+    typedef std::list<std::pair<std::string, TBoard> > Entries;
+
+    SolutionCache(const SolutionCache&);
+    SolutionCache& operator=(const SolutionCache&);
+
+    // Adds or refreshes an entry (mutex held). Returns false if it was there.
+    bool insert(const std::string& key, const TBoard& solution);
+
+    size_t      _capacity;
+    Entries     _entries;     // most recently used first
+    std::unordered_map<std::string, Entries::iterator> _index;
+    std::mutex  _mutex;
+    FILE*       _file;        // backing file (appended to), or NULL
+    long        _hits;
+    long        _misses;
+};
+
+#endif  // INCLUDE_SOLUTION_CACHE_H_
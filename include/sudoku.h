@@ -24,11 +24,148 @@
  * ----------------------------------------------------------------------------
  */
 
+#ifndef INCLUDE_SUDOKU_H_
+#define INCLUDE_SUDOKU_H_
+
+#include <rng.h>
+#include <telemetry.h>
+#include <checkpoint.h>
+#include <stdint.h>
+#include <atomic>
 #include <vector>
 #include <cstdio>
 
-typedef std::vector<std::vector<int> > TBoard;
-typedef std::vector<std::vector<bool> > TBoardBool;
+// A cell holds a value in [1, n], or 0 while empty. 16 bits are enough for
+// any order accepted by loadInstance (n = order^2 < 2500).
+typedef uint16_t TCell;
+
+// How many times a value shows up in a row or column (at most n).
+typedef uint16_t TCount;
+
+// Boards are stored row-major in a single buffer: cell (i,j) is at i*n + j.
+typedef std::vector<TCell> TBoard;
+typedef std::vector<uint8_t> TBoardMask;
+
+// How solve() picks the two cells of a move.
+enum MovePolicy {
+  kRandomMoves,     // a random square, then two of its free cells
+  kConflictMoves    // mostly a cell in conflict (see conflictBias), then
+                    // another free cell of its square
+};
+
+// Simulated Annealing settings (see main.cpp for the defaults).
+struct SAParams {
+  float         initialTemp;
+  float         alpha;          // temperature decrease in each stage
+  int           stagesLength;   // proposals per temperature stage
+  unsigned int  randomSeed;
+  double        maxSeconds;     // wall-clock budget (<= 0: no limit)
+  long long     maxProposals;   // proposals budget (<= 0: no limit)
+  int           stallStages;    // stages without improving before reheating
+                                // (<= 0: never, see StageSchedule)
+  bool          restart;        // on stall, restart from a new random initial
+                                // solution (at initialTemp) instead of only
+                                // reheating
+  int           targetCost;     // stop once the cost gets this low (e.g. to
+                                // hand off to another engine)
+  // Adaptive schedule: initialTemp <= 0 is replaced by the temperature that
+  // accepts about targetAcceptance of the moves from the initial board,
+  // stagesLength <= 0 by the number of free cells, and alpha follows the
+  // acceptance rate of each stage.
+  bool          adaptive;
+  float         targetAcceptance;
+  MovePolicy    moves;
+  float         conflictBias;   // kConflictMoves: share of the moves that
+                                // start from a conflicting cell (the rest
+                                // are random, so every move stays possible)
+  bool          rejectionFree;  // n-fold way once a stage accepts less than
+  float         rejectionFreeBelow;   // this share of its proposals
+
+  SAParams() : initialTemp(0), alpha(0.9), stagesLength(0), randomSeed(24),
+    maxSeconds(0), maxProposals(0), stallStages(0), restart(false),
+    targetCost(0), adaptive(false), targetAcceptance(0.5),
+    moves(kRandomMoves), conflictBias(0.3), rejectionFree(false),
+    rejectionFreeBelow(0.01) {}
+};
+
+// Why the annealing stopped.
+enum SAStatus {
+  kSolved,          // reached cost 0
+  kOutOfTime,       // maxSeconds ran out
+  kOutOfProposals,  // maxProposals ran out
+  kStopped,         // the stop flag was raised
+  kNoMoves,         // no square has two free cells to swap
+  kReachedTarget    // got down to targetCost (> 0)
+};
+
+// What solve() reports. The board is left at the best solution found.
+struct SAResult {
+  SAStatus    status;
+  int         initialSolution;  // cost of the first generated solution
+  int         finalSolution;    // cost of the best solution found
+  double      seconds;          // wall-clock seconds
+  double      cpuSeconds;       // CPU seconds of the solving thread
+  long long   proposals;        // moves proposed
+  long long   accepted;         // moves accepted
+  long long   uphillAccepted;   // uphill moves accepted (0 without
+                                // SUDOKU_TELEMETRY)
+  int         reheats;          // stalls handled (reheats or restarts)
+};
+
+// What StageSchedule::endStage() decided.
+enum StageEnd {
+  kStageGoOn,       // cool down and carry on
+  kStageNewBest,    // same, and the board is the best of the whole search
+  kStageReheat,     // stalled: carry on from the current board, warmer
+  kStageRestart     // stalled: the caller shuffles the free cells, and it
+                    // starts over from initialTemp
+};
+
+// The end of stage part of the annealing schedule: cooling, the best cost
+// and what to do on a stall. Shared by solve() and the lockstep engine (one
+// per lane), so both run the same schedule.
+//
+// A stall is measured against the best cost of the current run (since the
+// last reheat or restart), not of the whole search, and stages only count
+// once the run is at least as cold as where it found that best: a reheated
+// or restarted board gets to cool down again, then stallStages stages to
+// improve on where it started. A reheat goes to kReheatFactor^k times the
+// temperature that found the run's best (at most initialTemp), k being the
+// number of reheats in a row without an improvement, so reheats get warmer
+// until one gets the search out of its local minimum.
+struct StageSchedule {
+  static const int kReheatFactor = 4;
+
+  float       temperature;      // of the next stage
+  float       initialTemp;      // as measured by the adaptive schedule
+  float       bestTemp;         // of the stage that found runBestCost
+  int         bestCost;         // best of the whole search
+  int         runBestCost;      // best since the last reheat or restart
+  int         stall;            // stages without improving runBestCost
+  int         reheatLevel;      // reheats since runBestCost last improved
+  int         warmStages;       // stages since the last reheat or restart
+
+  // A new search from a board of cost 'cost', at 'temp'.
+  void start(float temp, int cost);
+  // Called after each stage, with the alpha it ran with and the cost it
+  // ended at.
+  StageEnd endStage(const SAParams& params, float alpha, int cost);
+};
+
+// Where solve() is between two temperature stages, besides the boards, the
+// random engine and the conflict set: what a checkpoint keeps of it.
+struct SAState {
+  StageSchedule schedule;
+  float       alpha;
+  int         stagesLength;
+  int         stage;            // stages done
+  bool        rejectionFree;    // in the rejection-free phase
+  bool        canRejectionFree;
+  SAResult    result;           // counters so far
+};
+
+// CPU seconds used so far by the calling thread.
+double threadCpuSeconds();
 
 // Representes a Sudoku game.
 // Loads instances from files and solve them using Simulated Annealing.
@@ -36,7 +173,23 @@ class Sudoku {
   public:
     // accessers
     TBoard board()  { return _board; }
-    int order()     { return _order; }
+    const TBoard& givens() const { return _givens; }
+    int order() const { return _order; }
+    int cell(int i, int j) const { return _board[i*_n + j]; }
+    int cost() const  { return _cost; }
+    // false if no square has two free cells, i.e. there are no moves at all
+    bool canMove() const { return !_movableSquares.empty(); }
+
+    // While *stop is false, solve() keeps going; once it becomes true, it
+    // gives up at the end of the current temperature stage. NULL disables it.
+    void setStopFlag(const std::atomic<bool>* stop) { _stop = stop; }
+    // solve() writes a record per temperature stage to 'trace' (only when
+    // built with SUDOKU_TELEMETRY). NULL disables it.
+    void setTrace(TraceWriter* trace) { _trace = trace; }
+    // solve() hands a snapshot of its state to 'writer' whenever it says one
+    // is due, and a last one if a budget or the stop flag ends the search
+    // (see checkpoint.h). NULL disables it.
+    void setCheckpoint(CheckpointWriter* writer) { _checkpoint = writer; }
 
     // constructor & destructor
     Sudoku ();
@@ -46,29 +199,188 @@ class Sudoku {
     // * methods *
     // ***********
 
-    // Loads instance from file, setting _board and _fixeds.
+    // Loads instance from file, setting _board and _fixeds. On failure (0)
+    // every loader leaves no instance loaded: order() is -1.
     int loadInstance(const char* filename, bool checkValidity = true);
+    // Same, from an open stream (reads exactly one instance).
+    int loadInstance(FILE* fin, bool checkValidity = true);
+    // Same, from order^4 values in memory (-1 or 0 for empty cells).
+    int loadInstance(int order, const int* cells, bool checkValidity = true);
+    // Same, parsing the text format from [begin, end). If 'next' isn't NULL,
+    // it gets the position right after the instance.
+    int loadInstanceText(const char* begin, const char* end,
+        const char** next, bool checkValidity = true);
+    // Same, from the packed cells of a binary corpus (see instance_io.h).
+    int loadPacked(int order, const void* cells, int cellBytes,
+        bool checkValidity = true);
+
+    // Replaces the current board (e.g. with one from another engine); the
+    // givens must be in place. Returns its cost.
+    int setBoard(const TBoard& board);
+
+    // Sets up the next solve() to carry on, bit for bit, from a checkpoint
+    // written by a solve() with setCheckpoint(); 'params' gets the settings
+    // it ran with, which the next solve() should get as well (budgets aside).
+    // The instance must be loaded (and presolved) as it was then. Returns 1,
+    // 0 if 'data' isn't a valid checkpoint or -1 if it's for other givens.
+    int loadCheckpoint(const std::vector<uint8_t>& data, SAParams* params);
+
+    // Back to the loaded (or presolved) board, so it can be solved again.
+    // Loading, resetting and solving again reuse the same buffers: once an
+    // instance of some order was solved, nothing else gets allocated for
+    // instances of that order.
+    void reset();
 
     bool isCellFixed(int i, int j);
 
+    // Rebuilds the per-square lists of free cells from _fixeds.
+    void buildFreeCellIndex();
+
+    // Constraint propagation on the givens (orders up to 8). Forced cells
+    // become fixed and the remaining candidates guide genInitSolution.
+    // Returns the number of cells it fixed, or -1 if it's unsolvable.
+    int presolve();
+
     // Generate initial solution
     // (see function definition for details on how it it's done)
     void genInitSolution();
 
+    // Swaps two cells, keeping the occurrence tables up to date.
     void swapCells(int i1, int j1, int i2, int j2);
 
+    // Cost variation that swapping (i1,j1) and (i2,j2) would cause.
+    // Only looks at the (at most) two rows and two columns involved.
+    int swapDelta(int i1, int j1, int i2, int j2);
+
+    // Solves the board with Simulated Annealing, within the budgets of
+    // 'params'. Returns true if it reached cost 0.
+    bool solve(const SAParams& params, SAResult* result);
     bool solve(float initialTemp, float alpha, int stagesLength,
         unsigned int randomSeed, int* initialSolution, int* finalSolution,
         double* seconds);
 
+    // Lower level search interface, used by solve() and by the engines that
+    // drive several boards at once (see tempering.h).
+    // Generates the initial solution and seeds the random engine.
+    int startSearch(unsigned int randomSeed);
+    // 'steps' proposals at a fixed temperature (stops early at cost 0).
+    // Returns the number of proposals made.
+    int metropolis(float temperature, int steps);
+    // Shuffles the values of the free cells inside each square.
+    int randomizeFreeCells();
+
     int evaluateCurrentSolution();
+    // Independent check that the board is a valid solution (rows, columns,
+    // squares and givens), e.g. before reporting it.
+    bool verifySolution();
+
+    // Rebuilds the row/column occurrence tables from the current board and
+    // returns its cost (same value as evaluateCurrentSolution()).
+    int buildOccurrenceTables();
 
     // Dump some current data.
     void dump();
     void dumpBoardToFile(const char* filename);
+    // A swap touches at most two rows and two columns, each changing the
+    // cost by at most 1: deltas are always in [-kMaxSwapDelta, kMaxSwapDelta].
+    static const int kMaxSwapDelta = 4;
+
   private:
-    TBoard      _board;     // represents the board itself
-    TBoardBool  _fixeds;    // flags fixed cells
+    int finishLoad(bool checkValidity);
+    int failLoad();
+    bool presolvePlace(int k, int v);
+    int unitCell(int u, int t);
+    void fillSquareFromCandidates(int sq);
+    static void buildAcceptTable(float temperature, uint64_t* acceptThreshold);
+    int runSweep(const uint64_t* acceptThreshold, int steps,
+        uint64_t conflictThreshold);
+    void rebuildConflicts();
+    bool buildRejectionFree();
+    void refreshSquareMoves(int sq);
+    void refreshValueMoves(int sq, int a, int b);
+    double squareWeight(int sq) const;
+    void setRejectionFreeTemp(float temperature);
+    int rejectionFreeSweep(int steps);
+    void saveBest();
+    void clearChanged();
+    void saveCheckpoint(const SAParams& params, const SAState& state);
+    uint64_t givensHash() const;
+    float sampleInitialTemp(float targetAcceptance);
+    static float adaptiveAlpha(float acceptance);
+    // Annealing inner loop. kOrder > 0 makes the order (and everything derived
+    // from it) a compile-time constant; kOrder == 0 uses _order at runtime.
+    // A move starts from a conflicting cell when 32 random bits fall below
+    // conflictThreshold (0: never, no random bits drawn). Returns the number
+    // of proposals made.
+    template <int kOrder>
+    int sweep(const uint64_t* acceptThreshold, int steps,
+        uint64_t conflictThreshold);
+
+    TBoard      _board;     // represents the board itself (search state)
+    TBoard      _givens;    // the board as loaded/presolved (free cells = 0)
+    TBoardMask  _fixeds;    // flags fixed cells
     int         _order;     // boards order = board will have a size of (order^2 x order^2)
     int         _n;         // holds order*order to avoid squaring _order everytime
+    // _rowCount[i*(_n+1) + v]: how many times value 'v' shows up in row 'i'.
+    // _colCount is the same for columns. Used for delta evaluation.
+    std::vector<TCount> _rowCount;
+    std::vector<TCount> _colCount;
+    // Free cells (as i*_n + j) grouped by square, square-major: the ones of
+    // square 's' are _freeCells[_squareStart[s] .. _squareStart[s+1]-1].
+    std::vector<int> _freeCells;
+    std::vector<int> _squareStart;
+    // Squares with at least two free cells, i.e. the ones a move can touch.
+    std::vector<int> _movableSquares;
+    // Candidates left by presolve() (bit v-1 set if v fits in the cell).
+    // Empty unless presolve() ran.
+    std::vector<uint64_t> _candidates;
+    // Scratch buffers, sized when loading so searches don't allocate.
+    std::vector<int> _scratch;            // n+1 marks, one per value
+    std::vector<uint64_t> _unitMasks;     // see bitboard.h
+    std::vector<int> _matchCellOf;        // used by fillSquareFromCandidates
+    std::vector<int> _matchValueOf;
+    std::vector<int> _matchStack;
+    std::vector<int> _matchParent;
+    std::vector<uint64_t> _matchTried;
+    RandomEngine _rng;  // seeded by startSearch()
+    int _cost;          // cost of the current board, kept by the search
+    TBoard _bestBoard;  // best board seen by solve()
+    // Free cells changed since _bestBoard was last updated, as an unordered
+    // set in _changedCells[0 .. _nChanged-1], so saveBest() only copies
+    // those; every free cell if _allChanged.
+    std::vector<int> _changedCells;
+    TBoardMask _cellChanged;          // membership, by cell
+    int _nChanged;
+    bool _allChanged;
+    const std::atomic<bool>* _stop;   // cooperative cancellation (may be NULL)
+    TraceWriter* _trace;              // per-stage trace (may be NULL)
+    CheckpointWriter* _checkpoint;    // snapshots of solve() (may be NULL)
+    std::vector<uint8_t> _snapshot;   // checkpoint buffer, reused
+    bool _resuming;                   // solve() starts from _resumeState
+    SAState _resumeState;
+    StageStats _stageStats;           // counters of the last sweep
+    // Conflict-directed moves: free cells (of movable squares) whose value
+    // repeats in their row or column, as an unordered set in
+    // _conflictCells[0 .. _nConflicts-1]. An accepted move adds its two
+    // cells if they conflict, and, for each value whose count in one of
+    // its rows or columns went from 1 to 2, the cell that already held it
+    // (a scan of that line). Cells are dropped lazily, when drawn and found
+    // fixed, so every conflicting cell is in the set.
+    std::vector<int> _conflictCells;
+    TBoardMask _inConflicts;          // membership, by cell
+    TBoardMask _conflictable;         // free cells of movable squares
+    int _nConflicts;
+    long long _conflictAge;           // proposals since the last rebuild
+    // Rejection-free search (see rejectionFreeSweep): the delta of every
+    // swap of two free cells of a square, square by square (pairs x < y in
+    // the order of _freeCells), a histogram of them per square (index
+    // delta + kMaxSwapDelta) and a Fenwick tree of the squares' weights.
+    std::vector<int8_t> _rfDelta;
+    std::vector<long long> _rfMoveStart;  // first move of each square
+    std::vector<int> _rfHist;
+    std::vector<double> _rfWeight;
+    std::vector<double> _rfTree;
+    double _rfAccept[2*kMaxSwapDelta+1];  // acceptance, by delta
 };
+
+#endif  // INCLUDE_SUDOKU_H_
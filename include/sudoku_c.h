@@ -0,0 +1,109 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_SUDOKU_C_H_
+#define INCLUDE_SUDOKU_C_H_
+
+// C interface to the solver, for embedding it (lib/libsudoku.a or .so)
+// without going through bin/sudoku. A sudoku_solver keeps its buffers between
+// calls: load, solve, reset and solve again don't allocate once an instance
+// of the same order has been solved. A solver must not be used by two threads
+// at once, except for sudoku_stop(), which may be called from anywhere.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sudoku_solver sudoku_solver;
+
+// Same meaning as SAParams (see sudoku.h). Values <= 0 for initial_temp and
+// stages_length mean the per-instance defaults (order*100 and order^2).
+typedef struct {
+  float         initial_temp;
+  float         alpha;
+  int           stages_length;
+  unsigned int  random_seed;
+  double        max_seconds;
+  long long     max_proposals;
+  int           stall_stages;
+  int           restart;
+} sudoku_params;
+
+// Same values as SAStatus.
+enum {
+  SUDOKU_SOLVED = 0,
+  SUDOKU_OUT_OF_TIME,
+  SUDOKU_OUT_OF_PROPOSALS,
+  SUDOKU_STOPPED,
+  SUDOKU_NO_MOVES
+};
+
+typedef struct {
+  int           status;
+  int           initial_cost;
+  int           final_cost;
+  double        seconds;
+  long long     proposals;
+} sudoku_result;
+
+sudoku_solver* sudoku_create(void);
+void sudoku_destroy(sudoku_solver* solver);
+
+// Defaults of bin/sudoku.
+void sudoku_default_params(sudoku_params* params);
+
+// Loaders. Return 1 on success, 0 if the input is malformed and -1 if some
+// given is repeated in a row, column or square. After a 0 no instance is
+// loaded: the calls below do nothing (solve returns 0, presolve -1) until a
+// load succeeds.
+// sudoku_load_cells takes order^4 values, row-major, -1 or 0 when empty.
+int sudoku_load_file(sudoku_solver* solver, const char* filename);
+int sudoku_load_cells(sudoku_solver* solver, int order, const int* cells);
+
+// Constraint propagation on the loaded givens. Returns the number of cells
+// it fixed, or -1 if the instance can't be solved.
+int sudoku_presolve(sudoku_solver* solver);
+
+// Anneals the loaded instance. Returns 1 if it got solved. The board is left
+// at the best solution found (see sudoku_get_cells).
+int sudoku_solve(sudoku_solver* solver, const sudoku_params* params,
+    sudoku_result* result);
+
+// Puts the board back as loaded (or presolved).
+void sudoku_reset(sudoku_solver* solver);
+
+// Asks a running sudoku_solve() to give up. It is cleared on the next solve.
+void sudoku_stop(sudoku_solver* solver);
+
+int sudoku_order(const sudoku_solver* solver);
+// Copies the current board (order^4 values, 0 for empty) to 'cells'.
+void sudoku_get_cells(const sudoku_solver* solver, int* cells);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // INCLUDE_SUDOKU_C_H_
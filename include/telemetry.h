@@ -0,0 +1,116 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_TELEMETRY_H_
+#define INCLUDE_TELEMETRY_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Annealing telemetry. Apart from the accepted moves, which the adaptive
+// schedule needs anyway, the counters in the inner loop and the trace only
+// exist when built with -DSUDOKU_TELEMETRY (make TELEMETRY=1); otherwise they
+// compile to nothing and the fields below stay at zero.
+#ifdef SUDOKU_TELEMETRY
+static const bool kTelemetryEnabled = true;
+#else
+static const bool kTelemetryEnabled = false;
+#endif
+
+// Counters of one temperature stage (or of a whole run).
+// rejected = proposals - accepted.
+struct StageStats {
+  long long     proposals;
+  long long     accepted;         // every accepted move, uphill or not
+  long long     uphillAccepted;   // accepted moves that raised the cost
+
+  StageStats() : proposals(0), accepted(0), uphillAccepted(0) {}
+};
+
+// One sample of the trace: the state at the end of a temperature stage.
+// The counters add up every stage since the previous record, so they sum
+// to the run's totals however the stages are sampled.
+struct TraceRecord {
+  int32_t       stage;
+  float         temperature;      // temperature the stage ran at
+  int32_t       cost;             // cost at the end of the stage
+  int32_t       bestCost;
+  int64_t       proposals;
+  int64_t       accepted;
+  int64_t       uphillAccepted;
+  int64_t       rejected;
+  double        seconds;          // wall-clock since solve() started
+};
+
+// Writes trace records to a file. Files ending in ".csv" get one text line
+// per record (with a header line); anything else gets the binary format:
+//   "SATRACE2" (8 bytes), uint32 record size, then the TraceRecord structs
+//   as they are in memory (native byte order).
+// Only one stage in 'every' is kept, plus every stage that found a new best.
+// Records are handed over in batches to a writer thread, which formats and
+// writes them, so the search only copies them into a buffer.
+class TraceWriter {
+  public:
+    TraceWriter();
+    ~TraceWriter();   // close()
+
+    // Returns false if the file can't be created.
+    bool open(const char* filename, int every = 1);
+    // True if the record of 'stage' is to be kept: only then does the
+    // caller need to fill it in and write() it.
+    bool wants(int stage, bool newBest) const {
+      return newBest || stage % _every == 0;
+    }
+    void write(const TraceRecord& record) {
+      _filling.push_back(record);
+      if (_filling.size() >= kBatchRecords) handOver();
+    }
+    // Writes what's pending, stops the writer thread and closes the file.
+    void close();
+    bool isOpen() const { return _file != NULL; }
+
+  private:
+    static const size_t kBatchRecords = 4096;
+
+    void handOver();
+    void writerLoop();
+
+    FILE* _file;
+    bool  _csv;
+    int   _every;
+    std::vector<TraceRecord> _filling;    // the search's side
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wake;        // signaled on handOver and close
+    std::vector<TraceRecord> _pending;    // handed over, not written yet
+    bool _closing;
+};
+
+#endif  // INCLUDE_TELEMETRY_H_
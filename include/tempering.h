@@ -0,0 +1,59 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_TEMPERING_H_
+#define INCLUDE_TEMPERING_H_
+
+#include <sudoku.h>
+
+// Outcome of a parallel tempering run.
+struct TemperingResult {
+  int     replica;          // replica whose board was kept
+  float   temperature;      // temperature it was at, when the run ended
+  int     initialSolution;  // lowest initial cost among the replicas
+  int     finalSolution;    // final cost of the kept replica (0 if solved)
+  long    rounds;           // number of sweep + exchange rounds
+  long    exchanges;        // exchange attempts
+  long    accepted;         // accepted exchanges
+  long long proposals;      // moves proposed, over all replicas
+  double  seconds;          // wall-clock seconds
+};
+
+// Parallel tempering (replica exchange) over copies of 'instance'.
+// 'replicas' boards are annealed at fixed temperatures, geometrically spaced
+// from minTemp to maxTemp. Every round each replica makes 'interval'
+// proposals (on 'threads' worker threads) and then neighbouring temperatures
+// try to exchange their boards, which is accepted with probability
+// min(1, exp((1/Ti - 1/Tj) * (Ei - Ej))). Even and odd pairs alternate.
+// Stops when some replica reaches cost 0, after maxSeconds (if > 0) or once
+// the replicas made maxProposals proposals in all (if > 0; checked after each
+// round), and copies the lowest cost replica back into 'instance'.
+// Replica k is seeded with randomSeed + k.
+bool solveTempering(Sudoku* instance, int replicas, float minTemp,
+    float maxTemp, int interval, int threads, unsigned int randomSeed,
+    double maxSeconds, long long maxProposals, TemperingResult* result);
+
+#endif  // INCLUDE_TEMPERING_H_
@@ -0,0 +1,267 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <batch.h>
+#include <lockstep.h>
+#include <sudoku.h>
+#include <solution_cache.h>
+#include <thread_pool.h>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Formats the result line of puzzle 'index'.
+std::string resultLine(long index, const char* status, int initialSolution,
+    int finalSolution, double seconds, const Sudoku* s) {
+  char buffer[96];
+  std::string line;
+  snprintf(buffer, sizeof(buffer), "%ld %s %d %d %f", index, status,
+      initialSolution, finalSolution, seconds);
+  line = buffer;
+  if (s != NULL) {
+    int n = s->order() * s->order();
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        snprintf(buffer, sizeof(buffer), " %d",
+            s->cell(i, j) > 0 ? s->cell(i, j) : -1);
+        line += buffer;
+      }
+    }
+  }
+  line += '\n';
+  return line;
+}
+
+// The per-puzzle budget of an order, see kBatchProposalsPerN4.
+void setDefaultBudget(int order, SAParams* params) {
+  const long long n = order * order;
+  if (params->maxSeconds > 0 || params->maxProposals > 0) return;
+  params->maxProposals = kBatchProposalsPerN4 * n*n*n*n;
+}
+
+}  // namespace
+
+void solveBatch(FILE* in, FILE* out, const BatchOptions& options,
+    BatchSummary* summary) {
+  solveBatch([in](Sudoku* s) {
+    int c;
+    // skip whitespace to tell the end of the stream from a broken instance
+    while ((c = fgetc(in)) != EOF && isspace(c)) {}
+    if (c == EOF) return kEndOfInput;
+    ungetc(c, in);
+    return s->loadInstance(in, true);
+  }, out, options, summary);
+}
+
+void solveBatch(const InstanceSource& next, FILE* out,
+    const BatchOptions& options, BatchSummary* summary) {
+  std::mutex mutex;
+  std::condition_variable progress;       // signaled when a puzzle finishes
+  std::map<long, std::string> finished;   // lines not written yet, by index
+  long nextToWrite = 0;
+  long inFlight = 0;
+  // Order 3 puzzles wait here for a lockstep annealer (see lockstep.h).
+  // Annealers are pool tasks, started as these puzzles come in, which quit
+  // as soon as they find the queue empty with all their lanes idle, so they
+  // never keep the threads that puzzles of other orders are waiting for.
+  std::deque<LockstepJob> lockstepQueue;
+  int lockstepWorkers = 0;
+  SAParams lockstepParams = options.params;
+  const bool lockstep = options.lockstep && !options.params.adaptive
+    && options.params.moves == kRandomMoves && !options.params.rejectionFree
+    && options.params.targetCost <= 0;
+  if (lockstepParams.initialTemp <= 0) lockstepParams.initialTemp = 3 * 100;
+  if (lockstepParams.stagesLength <= 0) lockstepParams.stagesLength = 3 * 3;
+  setDefaultBudget(3, &lockstepParams);
+
+  summary->puzzles = summary->solved = summary->failed = summary->invalid = 0;
+  summary->cached = 0;
+  std::chrono::steady_clock::time_point begin =
+    std::chrono::steady_clock::now();
+
+  ThreadPool pool(options.threads);
+  // bounds memory when the input is much faster to read than to solve
+  const long maxInFlight = (lockstep ? kLockstepLanes + 4L : 4L)
+    * pool.size();
+
+  // writes every finished line that is next in input order (mutex held)
+  std::function<void()> flush = [&]() {
+    std::map<long, std::string>::iterator it;
+    while ((it = finished.find(nextToWrite)) != finished.end()) {
+      fputs(it->second.c_str(), out);
+      finished.erase(it);
+      ++nextToWrite;
+    }
+    fflush(out);
+  };
+
+  // Looks 's' up in the cache (if any). Returns true if it was solved from
+  // it, with 'result' filled; 'form' gets its canonical form either way.
+  std::function<bool(Sudoku*, CanonicalForm*, SAResult*)> lookup =
+    [&](Sudoku* s, CanonicalForm* form, SAResult* result) {
+    TBoard cachedSolution;
+    if (options.cache == NULL) return false;
+    std::chrono::steady_clock::time_point lookupBegin =
+      std::chrono::steady_clock::now();
+    canonicalize(s->order(), s->givens(), form);
+    bool hit = options.cache->lookup(*form, &cachedSolution)
+      && s->setBoard(cachedSolution) == 0;
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - lookupBegin;
+    result->initialSolution = -1;
+    result->finalSolution = 0;
+    result->seconds = elapsed.count();
+    return hit;
+  };
+
+  // Reports puzzle 'index' (which reached cost 0 if 'solved') and deletes it.
+  std::function<void(long, Sudoku*, bool, bool, const SAResult&,
+      const CanonicalForm&)> finish = [&](long index, Sudoku* s, bool hit,
+      bool solved, const SAResult& result, const CanonicalForm& form) {
+    bool ok = solved && s->verifySolution();
+    if (ok && !hit && options.cache != NULL) {
+      options.cache->store(form, s->board());
+    }
+    // "error": the search claimed cost 0 but the board didn't verify
+    std::string line = resultLine(index,
+        ok ? "solved" : (solved ? "error" : "best"),
+        result.initialSolution, result.finalSolution, result.seconds, s);
+    delete s;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (ok) {
+      ++summary->solved;
+      if (hit) ++summary->cached;
+    } else {
+      ++summary->failed;
+    }
+    finished[index] = line;
+    flush();
+    --inFlight;
+    progress.notify_one();
+  };
+
+  // Pool task that anneals queued order 3 puzzles in lockstep.
+  std::function<void()> lockstepWorker = [&]() {
+    std::map<long, CanonicalForm> forms;  // of the puzzles in the lanes
+    solveLockstep(lockstepParams, [&](bool idle, LockstepJob* job) {
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          if (lockstepQueue.empty()) {
+            if (idle) --lockstepWorkers;  // solveLockstep() returns now
+            return false;
+          }
+          *job = lockstepQueue.front();
+          lockstepQueue.pop_front();
+        }
+        CanonicalForm form;
+        SAResult result;
+        if (!lookup(job->sudoku, &form, &result)) {
+          if (options.cache != NULL) forms[job->id] = form;
+          return true;
+        }
+        finish(job->id, job->sudoku, true, true, result, form);
+      }
+    }, [&](const LockstepJob& job, const SAResult& result) {
+      finish(job.id, job.sudoku, false, result.status == kSolved, result,
+          forms[job.id]);
+      forms.erase(job.id);
+    });
+  };
+
+  for (long index = 0; ; ++index) {
+    Sudoku* s = new Sudoku();
+    int loaded = next(s);
+    if (loaded == kEndOfInput) {
+      delete s;
+      break;
+    }
+    if (loaded == 1 && options.presolve && s->presolve() < 0) loaded = -1;
+    ++summary->puzzles;
+    if (loaded != 1) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ++summary->invalid;
+      finished[index] = resultLine(index, loaded == 0 ? "error" : "invalid",
+          -1, -1, 0, NULL);
+      flush();
+      delete s;
+      if (loaded == 0) break;
+      continue;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (inFlight >= maxInFlight) progress.wait(lock);
+      ++inFlight;
+    }
+    if (lockstep && s->order() == 3) {
+      LockstepJob job;
+      job.sudoku = s;
+      job.seed = options.params.randomSeed + index;
+      job.id = index;
+      std::unique_lock<std::mutex> lock(mutex);
+      lockstepQueue.push_back(job);
+      if (lockstepWorkers < pool.size()) {
+        ++lockstepWorkers;
+        pool.submit(lockstepWorker);
+      }
+      continue;
+    }
+    pool.submit([&, s, index]() {
+      int order = s->order();
+      SAParams params = options.params;
+      SAResult result;
+      CanonicalForm form;
+      if (!params.adaptive) {  // otherwise solve() measures them
+        if (params.initialTemp <= 0) params.initialTemp = order * 100;
+        if (params.stagesLength <= 0) params.stagesLength = order * order;
+      }
+      setDefaultBudget(order, &params);
+      params.randomSeed += index;
+      bool hit = lookup(s, &form, &result);
+      bool solved = hit || s->solve(params, &result);
+      finish(index, s, hit, solved, result, form);
+    });
+  }
+  pool.wait();
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    flush();
+  }
+
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - begin;
+  summary->seconds = elapsed.count();
+}
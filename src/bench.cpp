@@ -0,0 +1,429 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+// Benchmark suite: solves every instance of a corpus with a list of seeds,
+// in-process, and reports per instance:
+//  - runs, solved runs and success rate;
+//  - median, p90 and p99 wall time to solution (runs that didn't solve it
+//    count as infinite, so a p90 above the success rate shows as "inf");
+//  - mean final cost;
+//  - proposals per second, total wall and CPU seconds.
+// Results go to stdout and, optionally, to CSV and/or JSON files. A CSV from
+// a previous run can be given as a baseline to compare against.
+
+#include <sudoku.h>
+#include <thread_pool.h>
+#include <exact.h>
+#include <instance_io.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// One annealing run.
+struct Run {
+  unsigned int  seed;
+  bool          solved;
+  int           finalSolution;
+  double        seconds;
+  double        cpuSeconds;
+  long long     proposals;
+};
+
+// Everything measured on one instance.
+struct InstanceReport {
+  std::string   name;
+  int           runs;
+  int           solved;
+  double        successRate;
+  double        median, p90, p99;   // time to solution (inf if not reached)
+  double        meanFinalCost;
+  double        proposalsPerSecond;
+  double        wallSeconds;        // sum over the runs
+  double        cpuSeconds;         // sum over the runs
+};
+
+// Nearest-rank percentile of sorted values.
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return std::numeric_limits<double>::infinity();
+  size_t rank = static_cast<size_t>(ceil(p / 100.0 * sorted.size()));
+  if (rank < 1) rank = 1;
+  return sorted[rank - 1];
+}
+
+InstanceReport summarize(const std::string& name, const std::vector<Run>& runs) {
+  InstanceReport r;
+  std::vector<double> times;
+  long long proposals = 0;
+  double costs = 0;
+  r.name = name;
+  r.runs = runs.size();
+  r.solved = 0;
+  r.wallSeconds = r.cpuSeconds = 0;
+  for (size_t k = 0; k < runs.size(); ++k) {
+    if (runs[k].solved) ++r.solved;
+    times.push_back(runs[k].solved ? runs[k].seconds
+        : std::numeric_limits<double>::infinity());
+    costs += runs[k].finalSolution;
+    proposals += runs[k].proposals;
+    r.wallSeconds += runs[k].seconds;
+    r.cpuSeconds += runs[k].cpuSeconds;
+  }
+  std::sort(times.begin(), times.end());
+  r.successRate = r.runs > 0 ? static_cast<double>(r.solved) / r.runs : 0;
+  r.median = percentile(times, 50);
+  r.p90 = percentile(times, 90);
+  r.p99 = percentile(times, 99);
+  r.meanFinalCost = r.runs > 0 ? costs / r.runs : 0;
+  r.proposalsPerSecond = r.wallSeconds > 0 ? proposals / r.wallSeconds : 0;
+  return r;
+}
+
+void printNumber(FILE* out, double x, bool json) {
+  if (isinf(x)) {
+    fprintf(out, json ? "null" : "inf");
+  } else {
+    fprintf(out, "%.6f", x);
+  }
+}
+
+void writeCsv(FILE* out, const std::vector<InstanceReport>& reports) {
+  fprintf(out, "instance,runs,solved,success_rate,median_s,p90_s,p99_s,"
+      "mean_final_cost,proposals_per_s,wall_s,cpu_s\n");
+  for (size_t k = 0; k < reports.size(); ++k) {
+    const InstanceReport& r = reports[k];
+    fprintf(out, "%s,%d,%d,%.4f,", r.name.c_str(), r.runs, r.solved,
+        r.successRate);
+    printNumber(out, r.median, false);
+    fprintf(out, ",");
+    printNumber(out, r.p90, false);
+    fprintf(out, ",");
+    printNumber(out, r.p99, false);
+    fprintf(out, ",%.4f,%.0f,%.6f,%.6f\n", r.meanFinalCost,
+        r.proposalsPerSecond, r.wallSeconds, r.cpuSeconds);
+  }
+}
+
+void writeJson(FILE* out, const std::vector<InstanceReport>& reports) {
+  fprintf(out, "[\n");
+  for (size_t k = 0; k < reports.size(); ++k) {
+    const InstanceReport& r = reports[k];
+    fprintf(out, "  {\"instance\": \"%s\", \"runs\": %d, \"solved\": %d, "
+        "\"success_rate\": %.4f, ", r.name.c_str(), r.runs, r.solved,
+        r.successRate);
+    fprintf(out, "\"median_s\": ");
+    printNumber(out, r.median, true);
+    fprintf(out, ", \"p90_s\": ");
+    printNumber(out, r.p90, true);
+    fprintf(out, ", \"p99_s\": ");
+    printNumber(out, r.p99, true);
+    fprintf(out, ", \"mean_final_cost\": %.4f, \"proposals_per_s\": %.0f, "
+        "\"wall_s\": %.6f, \"cpu_s\": %.6f}%s\n", r.meanFinalCost,
+        r.proposalsPerSecond, r.wallSeconds, r.cpuSeconds,
+        k + 1 < reports.size() ? "," : "");
+  }
+  fprintf(out, "]\n");
+}
+
+// Reads a CSV written by writeCsv. Returns false if it can't be opened.
+bool readCsv(const char* filename, std::map<std::string, InstanceReport>* out) {
+  FILE* in = fopen(filename, "r");
+  char line[1024];
+  if (in == NULL) return false;
+  if (fgets(line, sizeof(line), in) == NULL) {  // header
+    fclose(in);
+    return true;
+  }
+  while (fgets(line, sizeof(line), in) != NULL) {
+    InstanceReport r;
+    char* fields[11];
+    int count = 0;
+    for (char* tok = strtok(line, ",\n"); tok && count < 11;  // NOLINT
+        tok = strtok(NULL, ",\n")) {  // NOLINT
+      fields[count++] = tok;
+    }
+    if (count < 11) continue;
+    r.name = fields[0];
+    r.runs = atoi(fields[1]);
+    r.solved = atoi(fields[2]);
+    r.successRate = atof(fields[3]);
+    r.median = atof(fields[4]);  // "inf" parses as infinity
+    r.p90 = atof(fields[5]);
+    r.p99 = atof(fields[6]);
+    r.meanFinalCost = atof(fields[7]);
+    r.proposalsPerSecond = atof(fields[8]);
+    r.wallSeconds = atof(fields[9]);
+    r.cpuSeconds = atof(fields[10]);
+    (*out)[r.name] = r;
+  }
+  fclose(in);
+  return true;
+}
+
+// Ratio new/old, printed as a percentage change.
+void printChange(const char* what, double now, double before) {
+  if (isinf(now) || isinf(before) || before == 0) {
+    printf("  %s: ", what);
+    printNumber(stdout, before, false);
+    printf(" -> ");
+    printNumber(stdout, now, false);
+    printf("\n");
+  } else {
+    printf("  %s: %f -> %f (%+.1f%%)\n", what, before, now,
+        100.0 * (now - before) / before);
+  }
+}
+
+void usage() {
+  printf("\nUsage: bench [options] [instance files...]\n");
+  printf("Solves each instance (default: etc/<order>_<fill>) with every seed.\n\n");  // NOLINT
+  printf("Options:\n");
+  printf("  -dir <D>      \t: Corpus directory, when no files are given. Default: etc\n");  // NOLINT
+  printf("  -seeds <N>    \t: Use seeds 1..N. Default: 10\n");
+  printf("  -seedlist <L> \t: Comma separated list of seeds (overrides -seeds)\n");  // NOLINT
+  printf("  -tl <N>       \t: Time limit per run, in seconds. Default: 10\n");
+  printf("  -it/-alpha/-sl/-stall <N>: Annealing settings, as in sudoku\n");
+  printf("  -restart      \t: Restart on stall, as in sudoku\n");
+  printf("  -adaptive     \t: Adaptive schedule, as in sudoku\n");
+  printf("  -rejectionfree\t: Rejection-free cold phase, as in sudoku\n");
+  printf("  -rfbelow <N>  \t: Acceptance rate that starts it, as in sudoku\n");
+  printf("  -moves <M>    \t: random or conflict, as in sudoku. Default: random\n");  // NOLINT
+  printf("  -bias <N>     \t: Share of conflict-directed moves, as in sudoku\n");  // NOLINT
+  printf("  -nopresolve   \t: Skip presolve\n");
+  printf("  -engine <E>   \t: sa, exact or hybrid, as in sudoku. Default: sa\n");
+  printf("  -threads <N>  \t: Runs in parallel (timings get noisier). Default: 1\n");  // NOLINT
+  printf("  -csv <F>      \t: Write the summary as CSV\n");
+  printf("  -json <F>     \t: Write the summary as JSON\n");
+  printf("  -baseline <F> \t: Compare against a CSV from a previous run\n");
+  printf("\n");
+}
+
+}  // namespace
+
+// Exit values: 0 ok, 4 invalid argument, 5 invalid value, 6 instance error.
+int main(int argc, char* argv[]) {
+  std::vector<std::string> files;
+  std::vector<unsigned int> seeds;
+  const char* dir = "etc";
+  const char *csvFilename = NULL, *jsonFilename = NULL, *baselineFilename = NULL;
+  std::string engine = "sa";
+  int nSeeds = 10, threads = 1;
+  bool presolve = true;
+  SAParams params;
+  float initialTemp = -1, stagesLength = -1;
+
+  params.maxSeconds = 10;
+  params.stallStages = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string str = argv[i];
+    bool hasValue = i+1 < argc;
+    if (str == "-h" || str == "-help") {
+      usage();
+      return 0;
+    } else if (str == "-nopresolve") {
+      presolve = false;
+    } else if (str == "-restart") {
+      params.restart = true;
+    } else if (str == "-adaptive") {
+      params.adaptive = true;
+    } else if (str == "-rejectionfree") {
+      params.rejectionFree = true;
+    } else if (str[0] != '-') {
+      files.push_back(str);
+    } else if (!hasValue) {
+      printf("\nMissing value for \"%s\"\n", argv[i]);
+      return 5;
+    } else if (str == "-engine") {
+      engine = argv[++i];
+    } else if (str == "-moves") {
+      std::string moves = argv[++i];
+      if (moves != "random" && moves != "conflict") {
+        printf("\nUnknown move policy \"%s\"\n", moves.c_str());
+        return 5;
+      }
+      params.moves = moves == "conflict" ? kConflictMoves : kRandomMoves;
+    } else if (str == "-bias") {
+      params.conflictBias = atof(argv[++i]);
+    } else if (str == "-rfbelow") {
+      params.rejectionFreeBelow = atof(argv[++i]);
+    } else if (str == "-dir") {
+      dir = argv[++i];
+    } else if (str == "-seeds") {
+      nSeeds = atoi(argv[++i]);
+    } else if (str == "-seedlist") {
+      for (char* tok = strtok(argv[++i], ","); tok; tok = strtok(NULL, ",")) {  // NOLINT
+        seeds.push_back(strtoul(tok, NULL, 10));
+      }
+    } else if (str == "-tl") {
+      params.maxSeconds = atof(argv[++i]);
+    } else if (str == "-it") {
+      initialTemp = atof(argv[++i]);
+    } else if (str == "-alpha") {
+      params.alpha = atof(argv[++i]);
+    } else if (str == "-sl") {
+      stagesLength = atof(argv[++i]);
+    } else if (str == "-stall") {
+      params.stallStages = atoi(argv[++i]);
+    } else if (str == "-threads") {
+      threads = atoi(argv[++i]);
+    } else if (str == "-csv") {
+      csvFilename = argv[++i];
+    } else if (str == "-json") {
+      jsonFilename = argv[++i];
+    } else if (str == "-baseline") {
+      baselineFilename = argv[++i];
+    } else {
+      printf("\nUnknown argument #%d \"%s\"\n", i, argv[i]);
+      usage();
+      return 4;
+    }
+  }
+  if (seeds.empty()) {
+    for (int k = 1; k <= nSeeds; ++k) seeds.push_back(k);
+  }
+  if (files.empty()) files = corpusFiles(dir);
+  if (engine != "sa" && engine != "exact" && engine != "hybrid") {
+    printf("\nUnknown engine \"%s\"\n", engine.c_str());
+    return 5;
+  }
+  if (files.empty() || seeds.empty() || threads < 1) {
+    printf("\nNothing to run (no instances, no seeds or no threads).\n");
+    return 5;
+  }
+
+  std::vector<InstanceReport> reports;
+  printf("%-16s %5s %7s %11s %11s %11s %9s %12s\n", "instance", "runs",
+      "success", "median(s)", "p90(s)", "p99(s)", "cost", "proposals/s");
+  for (size_t f = 0; f < files.size(); ++f) {
+    Sudoku base;
+    if (base.loadInstance(files[f].c_str(), true) != 1
+        || (presolve && base.presolve() < 0)) {
+      printf("\nError processing instance \"%s\".\n", files[f].c_str());
+      return 6;
+    }
+    SAParams instanceParams = params;
+    instanceParams.initialTemp = initialTemp > 0 ? initialTemp
+      : (params.adaptive ? 0 : base.order() * 100);
+    instanceParams.stagesLength = stagesLength > 0
+      ? static_cast<int>(stagesLength)
+      : (params.adaptive ? 0 : base.order() * base.order());
+
+    std::vector<Run> runs(seeds.size());
+    {
+      ThreadPool pool(threads);
+      for (size_t k = 0; k < seeds.size(); ++k) {
+        pool.submit([&, k]() {
+          Sudoku s = base;
+          SAParams mine = instanceParams;
+          double cpuBegin = threadCpuSeconds();
+          mine.randomSeed = seeds[k];
+          runs[k].seed = seeds[k];
+          if (engine == "exact") {
+            ExactResult result;
+            solveExact(&s, NULL, 0, mine.maxSeconds, &result);
+            runs[k].solved = result.status == kExactSolved;
+            runs[k].finalSolution = runs[k].solved ? 0 : -1;
+            runs[k].seconds = result.seconds;
+            runs[k].proposals = 0;
+          } else if (engine == "hybrid") {
+            HybridResult result;
+            HybridParams hybrid;
+            hybrid.handoffCost = s.order();
+            hybrid.freeCells = s.order()*s.order()*s.order()*s.order() / 2;
+            solveHybrid(&s, mine, hybrid, &result);
+            runs[k].solved = result.status == kSolved;
+            runs[k].finalSolution = result.finalSolution;
+            runs[k].seconds = result.seconds;
+            runs[k].proposals = result.proposals;
+          } else {
+            SAResult result;
+            runs[k].solved = s.solve(mine, &result);
+            runs[k].finalSolution = result.finalSolution;
+            runs[k].seconds = result.seconds;
+            runs[k].proposals = result.proposals;
+          }
+          runs[k].solved = runs[k].solved && s.verifySolution();
+          runs[k].cpuSeconds = threadCpuSeconds() - cpuBegin;
+        });
+      }
+      pool.wait();
+    }
+
+    std::string name = files[f].substr(files[f].find_last_of('/') + 1);
+    InstanceReport r = summarize(name, runs);
+    reports.push_back(r);
+    printf("%-16s %5d %6.1f%% ", r.name.c_str(), r.runs, 100 * r.successRate);
+    printf("%11.6f %11.6f %11.6f %9.2f %12.0f\n", r.median, r.p90, r.p99,
+        r.meanFinalCost, r.proposalsPerSecond);
+  }
+
+  if (csvFilename != NULL) {
+    FILE* out = fopen(csvFilename, "w");
+    if (out == NULL) {
+      printf("\nCouldn't create output file \"%s\"\n", csvFilename);
+      return 1;
+    }
+    writeCsv(out, reports);
+    fclose(out);
+  }
+  if (jsonFilename != NULL) {
+    FILE* out = fopen(jsonFilename, "w");
+    if (out == NULL) {
+      printf("\nCouldn't create output file \"%s\"\n", jsonFilename);
+      return 1;
+    }
+    writeJson(out, reports);
+    fclose(out);
+  }
+
+  if (baselineFilename != NULL) {
+    std::map<std::string, InstanceReport> baseline;
+    if (!readCsv(baselineFilename, &baseline)) {
+      printf("\nCouldn't open baseline file \"%s\"\n", baselineFilename);
+      return 3;
+    }
+    printf("\nCompared to baseline \"%s\":\n", baselineFilename);
+    for (size_t k = 0; k < reports.size(); ++k) {
+      std::map<std::string, InstanceReport>::iterator b =
+        baseline.find(reports[k].name);
+      if (b == baseline.end()) continue;
+      printf("%s\n", reports[k].name.c_str());
+      printChange("success rate", reports[k].successRate, b->second.successRate);
+      printChange("median (s)", reports[k].median, b->second.median);
+      printChange("p90 (s)", reports[k].p90, b->second.p90);
+      printChange("proposals/s", reports[k].proposalsPerSecond,
+          b->second.proposalsPerSecond);
+    }
+  }
+  return 0;
+}
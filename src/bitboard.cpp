@@ -0,0 +1,188 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <bitboard.h>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SUDOKU_AVX2_DISPATCH
+#endif
+
+namespace {
+
+inline int wordsPerMask(int n) { return (n + 63) / 64; }
+
+// Repeated values of 'units' masks of 'words' words each, for units of n
+// cells.
+inline int surplus(const uint64_t* masks, int units, int words, int n) {
+  int repeated = 0;
+  for (int u = 0; u < units; ++u) {
+    int distinct = 0;
+    for (int w = 0; w < words; ++w) {
+      distinct += __builtin_popcountll(masks[u*words + w]);
+    }
+    repeated += n - distinct;
+  }
+  return repeated;
+}
+
+// Any order. masks: rows, then columns, then squares, 'words' each.
+bool countConflictsScalar(const TCell* board, int order, uint64_t* masks,
+    BoardConflicts* out) {
+  const int n = order * order;
+  const int words = wordsPerMask(n);
+  uint64_t* rows = masks;
+  uint64_t* cols = masks + n*words;
+  uint64_t* squares = masks + 2*n*words;
+  memset(masks, 0, sizeof(uint64_t) * 3*n*words);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      const int v = board[i*n + j] - 1;
+      if (v < 0 || v >= n) return false;
+      const int w = v >> 6;
+      const uint64_t bit = 1ULL << (v & 63);
+      const int sq = (i / order)*order + j / order;
+      rows[i*words + w] |= bit;
+      cols[j*words + w] |= bit;
+      squares[sq*words + w] |= bit;
+    }
+  }
+  out->rows = surplus(rows, n, words, n);
+  out->cols = surplus(cols, n, words, n);
+  out->squares = surplus(squares, n, words, n);
+  return true;
+}
+
+#ifdef SUDOKU_AVX2_DISPATCH
+// n <= 64, one word per mask. Four cells at a time: widen the values to 64
+// bits, shift 1 by value-1 and OR the result into the four column masks and
+// into the row accumulator. Out of range values give 0 from the variable
+// shift and are flagged by the range compares.
+__attribute__((target("avx2,popcnt")))
+bool countConflictsAvx2(const TCell* board, int order, uint64_t* masks,
+    BoardConflicts* out) {
+  const int n = order * order;
+  uint64_t* rows = masks;
+  uint64_t* cols = masks + n;
+  uint64_t* squares = masks + 2*n;
+  uint64_t bits[64];  // bit of each cell of the current row
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i last = _mm256_set1_epi64x(n - 1);
+  __m256i bad = zero;
+  bool badTail = false;
+
+  memset(masks, 0, sizeof(uint64_t) * 3*n);
+  for (int i = 0; i < n; ++i) {
+    const TCell* row = board + i*n;
+    __m256i rowBits = zero;
+    uint64_t rowMask;
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+      __m128i v16 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + j));
+      __m256i v = _mm256_sub_epi64(_mm256_cvtepu16_epi64(v16), one);
+      __m256i b = _mm256_sllv_epi64(one, v);
+      __m256i* col = reinterpret_cast<__m256i*>(cols + j);
+      bad = _mm256_or_si256(bad, _mm256_or_si256(
+            _mm256_cmpgt_epi64(zero, v), _mm256_cmpgt_epi64(v, last)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(bits + j), b);
+      _mm256_storeu_si256(col, _mm256_or_si256(_mm256_loadu_si256(col), b));
+      rowBits = _mm256_or_si256(rowBits, b);
+    }
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(rowBits),
+        _mm256_extracti128_si256(rowBits, 1));
+    rowMask = static_cast<uint64_t>(_mm_cvtsi128_si64(half))
+      | static_cast<uint64_t>(_mm_extract_epi64(half, 1));
+    for (; j < n; ++j) {
+      const int v = row[j] - 1;
+      if (v < 0 || v >= n) badTail = true;
+      bits[j] = v < 0 || v >= n ? 0 : 1ULL << v;
+      cols[j] |= bits[j];
+      rowMask |= bits[j];
+    }
+    rows[i] = rowMask;
+    for (int s = 0; s < order; ++s) {
+      uint64_t m = 0;
+      for (int q = 0; q < order; ++q) m |= bits[s*order + q];
+      squares[(i / order)*order + s] |= m;
+    }
+  }
+  if (badTail || !_mm256_testz_si256(bad, bad)) return false;
+  out->rows = surplus(rows, n, 1, n);
+  out->cols = surplus(cols, n, 1, n);
+  out->squares = surplus(squares, n, 1, n);
+  return true;
+}
+
+bool cpuHasAvx2() {
+  static const bool has = __builtin_cpu_supports("avx2")
+    && __builtin_cpu_supports("popcnt");
+  return has;
+}
+#endif
+
+}  // namespace
+
+int bitboardScratchSize(int order) {
+  const int n = order * order;
+  return 3 * n * wordsPerMask(n);
+}
+
+bool countConflicts(const TCell* board, int order, uint64_t* scratch,
+    BoardConflicts* out) {
+#ifdef SUDOKU_AVX2_DISPATCH
+  if (order * order <= 64 && cpuHasAvx2()) {
+    return countConflictsAvx2(board, order, scratch, out);
+  }
+#endif
+  return countConflictsScalar(board, order, scratch, out);
+}
+
+int findRepeatedValue(const TCell* board, int order, uint64_t* scratch) {
+  const int n = order * order;
+  const int words = wordsPerMask(n);
+  uint64_t* rows = scratch;
+  uint64_t* cols = scratch + n*words;
+  uint64_t* squares = scratch + 2*n*words;
+  memset(scratch, 0, sizeof(uint64_t) * 3*n*words);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      const int v = board[i*n + j] - 1;
+      if (v < 0) continue;
+      const int w = v >> 6;
+      const uint64_t bit = 1ULL << (v & 63);
+      uint64_t* r = rows + i*words + w;
+      uint64_t* c = cols + j*words + w;
+      uint64_t* s = squares + ((i / order)*order + j / order)*words + w;
+      if ((*r | *c | *s) & bit) return i*n + j;
+      *r |= bit;
+      *c |= bit;
+      *s |= bit;
+    }
+  }
+  return -1;
+}
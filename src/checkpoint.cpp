@@ -0,0 +1,134 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <checkpoint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+CheckpointWriter::CheckpointWriter() : _everySeconds(0), _lastSeconds(0),
+  _hasPending(false), _closing(false), _written(0), _failed(false) {}
+
+CheckpointWriter::~CheckpointWriter() {
+  close();
+}
+
+bool CheckpointWriter::open(const char* filename, double everySeconds) {
+  FILE* probe;
+  close();
+  // fail now rather than in the background, at the first checkpoint
+  probe = fopen((std::string(filename) + ".tmp").c_str(), "wb");
+  if (probe == NULL) return false;
+  fclose(probe);
+  remove((std::string(filename) + ".tmp").c_str());
+  _filename = filename;
+  _everySeconds = everySeconds;
+  _lastSeconds = 0;
+  _hasPending = _closing = _failed = false;
+  _written = 0;
+  _thread = std::thread(&CheckpointWriter::writerLoop, this);
+  return true;
+}
+
+void CheckpointWriter::close() {
+  if (!_thread.joinable()) return;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _closing = true;
+  }
+  _wake.notify_one();
+  _thread.join();
+}
+
+bool CheckpointWriter::due(double seconds) const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return seconds - _lastSeconds >= _everySeconds;
+}
+
+void CheckpointWriter::submit(std::vector<uint8_t>* snapshot,
+    double seconds) {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _pending.swap(*snapshot);
+    _hasPending = true;
+    _lastSeconds = seconds;
+  }
+  _wake.notify_one();
+}
+
+long CheckpointWriter::written() const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _written;
+}
+
+bool CheckpointWriter::failed() const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _failed;
+}
+
+// Takes the pending snapshot (the buffers only change hands under the lock)
+// and writes it next to the file, syncs and renames it over the file.
+void CheckpointWriter::writerLoop() {
+  const std::string temporary = _filename + ".tmp";
+  std::vector<uint8_t> writing;
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    while (!_hasPending && !_closing) _wake.wait(lock);
+    if (!_hasPending) break;
+    writing.swap(_pending);
+    _hasPending = false;
+    lock.unlock();
+
+    bool ok = false;
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (out != NULL) {
+      ok = fwrite(&writing[0], 1, writing.size(), out) == writing.size()
+        && fflush(out) == 0 && fsync(fileno(out)) == 0;
+      ok = fclose(out) == 0 && ok;
+      ok = ok && rename(temporary.c_str(), _filename.c_str()) == 0;
+    }
+
+    lock.lock();
+    if (ok) {
+      ++_written;
+    } else {
+      _failed = true;
+    }
+  }
+}
+
+bool readCheckpoint(const char* filename, std::vector<uint8_t>* data) {
+  FILE* in = fopen(filename, "rb");
+  uint8_t buffer[4096];
+  size_t got;
+  if (in == NULL) return false;
+  data->clear();
+  while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+    data->insert(data->end(), buffer, buffer + got);
+  }
+  bool ok = !ferror(in);
+  fclose(in);
+  return ok;
+}
@@ -0,0 +1,123 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+// Converts between the text instance format of etc/ (one or more instances,
+// concatenated) and the binary corpus format of instance_io.h:
+//   convert <input> <output>
+// A binary input is written out as text, anything else is parsed as text and
+// written out as a binary corpus. Output "-" means stdout (text only).
+
+#include <sudoku.h>
+#include <instance_io.h>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// Writes the givens of 's' in the text format.
+void writeText(FILE* out, const Sudoku& s) {
+  const int n = s.order() * s.order();
+  const TBoard& givens = s.givens();
+  fprintf(out, "%d\n", s.order());
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      fprintf(out, "%d\t", givens[i*n + j] > 0 ? givens[i*n + j] : -1);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+}  // namespace
+
+// Exit values: 0 ok, 1 can't write the output, 3 can't open the input,
+// 4 invalid argument, 6 malformed input.
+int main(int argc, char* argv[]) {
+  MappedFile file;
+  Sudoku s;
+  long count = 0;
+
+  if (argc != 3) {
+    printf("\nUsage: convert <input> <output>\n");
+    printf("Text instances become a binary corpus and vice versa.\n\n");
+    return 4;
+  }
+  if (!file.open(argv[1])) {
+    printf("\nCouldn't open input file \"%s\"\n", argv[1]);
+    return 3;
+  }
+
+  if (Corpus::isCorpus(file.data(), file.size())) {
+    Corpus corpus;
+    FILE* out = strcmp(argv[2], "-") == 0 ? stdout : fopen(argv[2], "w");
+    if (out == NULL) {
+      printf("\nCouldn't create output file \"%s\"\n", argv[2]);
+      return 1;
+    }
+    if (!corpus.open(file)) {
+      printf("\nInvalid corpus file \"%s\"\n", argv[1]);
+      return 6;
+    }
+    for (; count < corpus.size(); ++count) {
+      if (corpus.load(count, &s, false) != 1) {
+        printf("\nInvalid instance #%ld\n", count);
+        return 6;
+      }
+      writeText(out, s);
+    }
+    if (out != stdout && fclose(out) != 0) return 1;
+  } else {
+    CorpusWriter writer;
+    const char* cursor = file.data();
+    const char* end = file.data() + file.size();
+    if (strcmp(argv[2], "-") == 0) {
+      printf("\nA binary corpus can't be written to stdout (\"-\")\n");
+      return 4;
+    }
+    if (!writer.open(argv[2])) {
+      printf("\nCouldn't create output file \"%s\"\n", argv[2]);
+      return 1;
+    }
+    while (true) {
+      while (cursor < end && isspace(*cursor)) ++cursor;
+      if (cursor == end) break;
+      if (s.loadInstanceText(cursor, end, &cursor, false) != 1) {
+        printf("\nInvalid instance #%ld\n", count);
+        return 6;
+      }
+      if (!writer.add(s.order(), &s.givens()[0])) break;
+      ++count;
+    }
+    if (!writer.close()) {
+      printf("\nCouldn't write output file \"%s\"\n", argv[2]);
+      return 1;
+    }
+  }
+  if (strcmp(argv[2], "-") != 0) {
+    printf("%ld instances written to \"%s\".\n", count, argv[2]);
+  }
+  return 0;
+}
@@ -0,0 +1,362 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <exact.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// checking the clock at every node would cost more than the node itself
+const long long kClockCheckInterval = 1024;
+
+// what is left of a time budget always stays a budget (0 would mean none)
+const double kMinSecondsLeft = 0.001;
+
+// Depth-first search state. _empty holds the free cells; the ones before the
+// current depth are filled, in the order they were chosen.
+class Search {
+  public:
+    // Returns false if the order is above 8.
+    bool init(const Sudoku& s, const TCell* hint);
+    // Looks for up to 'limit' solutions; the last one found is kept in
+    // solution(). Sets *outOfBudget if it had to stop early.
+    int run(int limit, long long maxNodes, double maxSeconds,
+        bool* outOfBudget);
+    const TBoard& solution() const { return _solution; }
+    long long nodes() const { return _nodes; }
+
+  private:
+    int squareOf(int k) const {
+      return (k / _n / _order)*_order + (k % _n) / _order;
+    }
+    uint64_t candidates(int k) const {
+      return ~(_rows[k / _n] | _cols[k % _n] | _squares[squareOf(k)]) & _all;
+    }
+    void place(int k, int v);
+    void unplace(int k);
+    // Cell index of the t-th cell of unit u (rows, columns, squares).
+    int unitCell(int u, int t) const;
+    // Chooses the cell to branch on at depth d: moves it to _empty[d] and
+    // stores the values to try in _left[d] (0 for a dead end).
+    void select(int d);
+    void moveTo(int d, int t);
+
+    int                   _order, _n;
+    uint64_t              _all;         // bits of every value
+    bool                  _consistent;  // no given repeated
+    TBoard                _board, _solution;
+    std::vector<uint64_t> _rows, _cols, _squares;
+    std::vector<int>      _empty;
+    std::vector<int>      _position;    // _empty[_position[k]] == k
+    std::vector<uint64_t> _left;        // values not tried yet, per depth
+    const TCell*          _hint;
+    long long             _nodes;
+};
+
+bool Search::init(const Sudoku& s, const TCell* hint) {
+  _order = s.order();
+  _n = _order * _order;
+  if (_order < 1 || _n > 64) return false;
+  _all = _n == 64 ? ~0ULL : (1ULL << _n) - 1;
+  _board = s.givens();
+  _rows.assign(_n, 0);
+  _cols.assign(_n, 0);
+  _squares.assign(_n, 0);
+  _empty.clear();
+  _position.assign(_n*_n, -1);
+  _hint = hint;
+  _nodes = 0;
+  _consistent = true;
+  for (int k = 0; k < _n*_n; ++k) {
+    if (_board[k] == 0) {
+      _position[k] = _empty.size();
+      _empty.push_back(k);
+    } else if (candidates(k) & (1ULL << (_board[k]-1))) {
+      place(k, _board[k]);
+    } else {
+      _consistent = false;
+    }
+  }
+  _left.assign(_empty.size() + 1, 0);
+  return true;
+}
+
+void Search::place(int k, int v) {
+  const uint64_t bit = 1ULL << (v-1);
+  _board[k] = v;
+  _rows[k / _n] |= bit;
+  _cols[k % _n] |= bit;
+  _squares[squareOf(k)] |= bit;
+}
+
+void Search::unplace(int k) {
+  const uint64_t bit = ~(1ULL << (_board[k]-1));
+  _rows[k / _n] &= bit;
+  _cols[k % _n] &= bit;
+  _squares[squareOf(k)] &= bit;
+  _board[k] = 0;
+}
+
+int Search::unitCell(int u, int t) const {
+  if (u < _n) return u*_n + t;
+  if (u < 2*_n) return t*_n + (u - _n);
+  u -= 2*_n;
+  return ((u / _order)*_order + t / _order)*_n + (u % _order)*_order
+    + t % _order;
+}
+
+void Search::moveTo(int d, int t) {
+  std::swap(_empty[d], _empty[t]);
+  _position[_empty[d]] = d;
+  _position[_empty[t]] = t;
+}
+
+// Cell with the fewest candidates (MRV). When every cell still has two or
+// more, a value that fits in a single cell of some unit (hidden single) is
+// forced there instead, and a value that fits nowhere in a unit ends the
+// branch.
+void Search::select(int d) {
+  const int m = _empty.size();
+  int best = d, bestCount = _n + 1;
+  uint64_t bestCandidates = 0;
+  for (int t = d; t < m; ++t) {
+    uint64_t c = candidates(_empty[t]);
+    int count = __builtin_popcountll(c);
+    if (count < bestCount) {
+      best = t;
+      bestCount = count;
+      bestCandidates = c;
+      if (count <= 1) break;  // can't do better
+    }
+  }
+  moveTo(d, best);
+  _left[d] = bestCandidates;
+  if (bestCount <= 1) return;
+
+  for (int u = 0; u < 3*_n; ++u) {
+    uint64_t once = 0, twice = 0, used = 0;
+    for (int t = 0; t < _n; ++t) {
+      const int k = unitCell(u, t);
+      if (_board[k] != 0) {
+        used |= 1ULL << (_board[k]-1);
+      } else {
+        const uint64_t c = candidates(k);
+        twice |= once & c;
+        once |= c;
+      }
+    }
+    if ((once | used) != _all) {  // some value fits nowhere in this unit
+      _left[d] = 0;
+      return;
+    }
+    const uint64_t singles = once & ~twice;
+    if (singles == 0) continue;
+    for (int t = 0; t < _n; ++t) {
+      const int k = unitCell(u, t);
+      const uint64_t c = _board[k] == 0 ? candidates(k) & singles : 0;
+      if (c != 0) {
+        moveTo(d, _position[k]);
+        _left[d] = c & (~c + 1);
+        return;
+      }
+    }
+  }
+}
+
+int Search::run(int limit, long long maxNodes, double maxSeconds,
+    bool* outOfBudget) {
+  const int m = _empty.size();
+  Clock::time_point begin = Clock::now();
+  int found = 0, d = 0;
+
+  *outOfBudget = false;
+  if (!_consistent) return 0;
+  if (m == 0) {
+    _solution = _board;
+    return 1;
+  }
+  select(0);
+  while (true) {
+    if (_left[d] == 0) {  // every value failed here: back to the last choice
+      if (d == 0) break;
+      unplace(_empty[--d]);
+      continue;
+    }
+    const int k = _empty[d];
+    uint64_t bit = _left[d] & (~_left[d] + 1);  // lowest value
+    if (_hint != NULL && _hint[k] > 0 && (_left[d] & (1ULL << (_hint[k]-1)))) {
+      bit = 1ULL << (_hint[k]-1);
+    }
+    _left[d] &= ~bit;
+    place(k, __builtin_ctzll(bit) + 1);
+    ++_nodes;
+    if ((maxNodes > 0 && _nodes >= maxNodes)
+        || (maxSeconds > 0 && _nodes % kClockCheckInterval == 0
+          && std::chrono::duration<double>(Clock::now() - begin).count()
+            >= maxSeconds)) {
+      *outOfBudget = true;
+      break;
+    }
+    if (d + 1 == m) {  // every cell filled
+      _solution = _board;
+      if (++found >= limit) break;
+      unplace(k);
+      continue;
+    }
+    select(++d);
+  }
+  return found;
+}
+
+}  // namespace
+
+ExactStatus solveExact(Sudoku* instance, const TCell* hint,
+    long long maxNodes, double maxSeconds, ExactResult* result) {
+  Clock::time_point begin = Clock::now();
+  Search search;
+  bool outOfBudget;
+  int found;
+
+  result->nodes = 0;
+  result->seconds = 0;
+  if (!search.init(*instance, hint)) {
+    result->status = kExactUnsupported;
+    return result->status;
+  }
+  found = search.run(1, maxNodes, maxSeconds, &outOfBudget);
+  if (found > 0) {
+    instance->setBoard(search.solution());
+    result->status = kExactSolved;
+  } else {
+    result->status = outOfBudget ? kExactOutOfBudget : kExactNoSolution;
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - begin;
+  result->nodes = search.nodes();
+  result->seconds = elapsed.count();
+  return result->status;
+}
+
+int countSolutions(const Sudoku& instance, int limit, long long maxNodes) {
+  Search search;
+  bool outOfBudget;
+  int found;
+  if (!search.init(instance, NULL)) return -1;
+  found = search.run(limit, maxNodes, 0, &outOfBudget);
+  return outOfBudget ? -1 : found;
+}
+
+bool solveHybrid(Sudoku* instance, const SAParams& params,
+    const HybridParams& hybrid, HybridResult* result) {
+  Clock::time_point begin = Clock::now();
+  const int n = instance->order() * instance->order();
+  const bool exactFits = n <= 64;
+  long long exactNodes = hybrid.exactNodes;
+  double sliceSeconds = hybrid.sliceSeconds;
+  int freeCells = 0;
+  ExactResult exact;
+
+  result->status = kNoMoves;
+  result->initialSolution = result->finalSolution = -1;
+  result->handoffs = 0;
+  result->solvedByExact = false;
+  result->unsolvable = false;
+  result->proposals = 0;
+  result->nodes = 0;
+  for (size_t k = 0; k < instance->givens().size(); ++k) {
+    if (instance->givens()[k] == 0) ++freeCells;
+  }
+
+  // few free cells: try the exact engine straight away
+  if (exactFits && freeCells <= hybrid.freeCells) {
+    ++result->handoffs;
+    solveExact(instance, NULL, exactNodes, params.maxSeconds, &exact);
+    result->nodes += exact.nodes;
+    result->solvedByExact = exact.status == kExactSolved;
+    result->unsolvable = exact.status == kExactNoSolution;
+    exactNodes *= 2;
+  }
+
+  for (unsigned int round = 0;
+      !result->solvedByExact && !result->unsolvable; ++round) {
+    SAParams annealing = params;
+    SAResult sa;
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    double left = params.maxSeconds > 0
+      ? params.maxSeconds - elapsed.count() : sliceSeconds;
+    if (left <= 0) {
+      result->status = kOutOfTime;
+      break;
+    }
+    annealing.randomSeed = params.randomSeed + round;
+    annealing.targetCost = exactFits ? hybrid.handoffCost : 0;
+    // the annealing gets a time slice, unless the exact engine can't help
+    annealing.maxSeconds = exactFits ? std::min(sliceSeconds, left)
+      : params.maxSeconds;
+    if (params.maxProposals > 0) {
+      annealing.maxProposals = params.maxProposals - result->proposals;
+      if (annealing.maxProposals <= 0) {
+        result->status = kOutOfProposals;
+        break;
+      }
+    }
+    instance->solve(annealing, &sa);
+    result->proposals += sa.proposals;
+    if (result->initialSolution < 0) {
+      result->initialSolution = sa.initialSolution;
+    }
+    result->status = sa.status;
+    if (!exactFits || sa.status == kSolved || sa.status == kStopped
+        || sa.status == kOutOfProposals || sa.status == kNoMoves) {
+      break;
+    }
+
+    // hand off (at the target cost or at the end of the slice), led by the
+    // annealing board; slices and node budgets double every round, so a
+    // long enough run is complete
+    const TBoard hint = instance->board();
+    elapsed = Clock::now() - begin;
+    ++result->handoffs;
+    solveExact(instance, &hint[0], exactNodes, params.maxSeconds > 0
+        ? std::max(params.maxSeconds - elapsed.count(), kMinSecondsLeft) : 0,
+        &exact);
+    result->nodes += exact.nodes;
+    result->solvedByExact = exact.status == kExactSolved;
+    result->unsolvable = exact.status == kExactNoSolution;
+    exactNodes *= 2;
+    sliceSeconds *= 2;
+  }
+
+  if (result->solvedByExact) result->status = kSolved;
+  if (result->unsolvable) result->status = kNoMoves;
+  std::chrono::duration<double> elapsed = Clock::now() - begin;
+  result->finalSolution = result->status == kSolved ? 0 : instance->cost();
+  result->seconds = elapsed.count();
+  return result->status == kSolved;
+}
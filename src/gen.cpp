@@ -0,0 +1,384 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+// Instance generator, mainly for benchmark corpora and orders beyond the ones
+// in etc/:
+//   gen <order> <fill %> [-rs <seed>] [-o <file>] [-count <N>]
+//       [-threads <N>] [-grid random|pattern] [-unique] [-corpus]
+// Each instance starts from a complete grid:
+//  - random (orders up to 8, default up to 6): the diagonal squares get
+//    shuffled values (they don't share lines) and the exact engine fills
+//    the rest, trying a random value first in each cell. A search that runs
+//    long is restarted from other squares, and after a few the pattern grid
+//    is used (above order 6 that's common);
+//  - pattern (any order): value(i,j) = (order*(i % order) + i/order + j) % n
+//    + 1.
+// The grid is then shuffled with moves that keep it a solution (relabeling
+// the values, permuting rows inside bands, bands, columns inside stacks and
+// stacks, and maybe transposing) and 'fill %' of the cells are kept as
+// givens. With -unique, givens are removed one by one in random order only
+// while the exact engine proves the solution is still unique, so an
+// instance may end above the fill asked for. The output uses the instance
+// format of etc/ (instances concatenated) or, with -corpus, the binary
+// corpus of include/instance_io.h.
+// Instance k uses the seed k * 2^32 + seed, so the output only depends on
+// the seed (not on the threads), and instance 0 is the one older versions
+// wrote for the same seed with the pattern grid.
+
+#include <sudoku.h>
+#include <exact.h>
+#include <instance_io.h>
+#include <rng.h>
+#include <thread_pool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Exact search budgets (nodes): completing a random grid before trying
+// another one (and at last the pattern grid), and proving a removal keeps
+// the solution unique (else the given stays). Random grids of order 6 mostly
+// take a few thousand nodes, with a long tail that restarts cut.
+const long long kGridNodes = 20000;
+const int kGridAttempts = 8;
+const long long kUniqueNodes = 200000;
+
+// Instances generated between two writes, per thread.
+const int kBlockPerThread = 64;
+
+struct GenOptions {
+  int   order;
+  int   fill;
+  bool  randomGrid;
+  bool  unique;
+};
+
+struct GenInstance {
+  TBoard  givens;     // 0 for the empty cells
+  bool    aboveFill;  // -unique couldn't remove enough givens
+  bool    pattern;    // the random grid fell back to the pattern one
+};
+
+// Fisher-Yates shuffle of 'v' with 'rng'.
+void shuffle(std::vector<int>* v, RandomEngine* rng) {
+  for (int k = static_cast<int>(v->size()) - 1; k > 0; --k) {
+    std::swap((*v)[k], (*v)[rng->below(k + 1)]);
+  }
+}
+
+// Random permutation of the n lines that keeps each group of 'order' lines
+// (band or stack) together.
+std::vector<int> linePermutation(int order, RandomEngine* rng) {
+  std::vector<int> groups(order), inside(order), lines;
+  for (int k = 0; k < order; ++k) groups[k] = k;
+  shuffle(&groups, rng);
+  for (int g = 0; g < order; ++g) {
+    for (int k = 0; k < order; ++k) inside[k] = k;
+    shuffle(&inside, rng);
+    for (int k = 0; k < order; ++k) {
+      lines.push_back(groups[g]*order + inside[k]);
+    }
+  }
+  return lines;
+}
+
+void patternGrid(int order, TBoard* grid) {
+  const int n = order * order;
+  grid->resize(n*n);
+  for (int r = 0; r < n; ++r) {
+    for (int c = 0; c < n; ++c) {
+      (*grid)[r*n + c] = (order*(r % order) + r / order + c) % n + 1;
+    }
+  }
+}
+
+// Completes a grid with the exact engine from shuffled diagonal squares.
+// Returns false if it ran out of budget (or the order is above 8).
+bool randomGrid(int order, RandomEngine* rng, TBoard* grid) {
+  const int n = order * order;
+  std::vector<int> cells(n*n, -1), values(n);
+  TBoard hint(n*n);
+  for (int v = 0; v < n; ++v) values[v] = v + 1;
+  for (int s = 0; s < order; ++s) {
+    shuffle(&values, rng);
+    for (int t = 0; t < n; ++t) {
+      cells[(s*order + t / order)*n + s*order + t % order] = values[t];
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    shuffle(&values, rng);
+    for (int j = 0; j < n; ++j) hint[i*n + j] = values[j];
+  }
+  Sudoku s;
+  ExactResult result;
+  if (s.loadInstance(order, cells.data(), false) != 1) return false;
+  if (solveExact(&s, hint.data(), kGridNodes, 0, &result) != kExactSolved) {
+    return false;
+  }
+  *grid = s.board();
+  return true;
+}
+
+// Relabels the values, permutes the lines and maybe transposes 'grid'.
+void transformGrid(int order, RandomEngine* rng, TBoard* grid) {
+  const int n = order * order;
+  std::vector<int> values(n);
+  for (int v = 0; v < n; ++v) values[v] = v + 1;
+  shuffle(&values, rng);
+  std::vector<int> rows = linePermutation(order, rng);
+  std::vector<int> cols = linePermutation(order, rng);
+  const bool transpose = rng->below(2) == 1;
+  TBoard out(n*n);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      const int r = transpose ? cols[j] : rows[i];
+      const int c = transpose ? rows[i] : cols[j];
+      out[i*n + j] = values[(*grid)[r*n + c] - 1];
+    }
+  }
+  grid->swap(out);
+}
+
+// Removes givens from the complete grid in 'g' while the solution stays
+// unique, down to 'givens' of them.
+void removeUnique(int order, int givens, RandomEngine* rng, GenInstance* g) {
+  const int cells = order * order * order * order;
+  std::vector<int> picks(cells), board(g->givens.begin(), g->givens.end());
+  Sudoku s;
+  int left = cells;
+  for (int k = 0; k < cells; ++k) picks[k] = k;
+  shuffle(&picks, rng);
+  for (int k = 0; k < cells && left > givens; ++k) {
+    const int cell = picks[k];
+    board[cell] = 0;
+    if (s.loadInstance(order, board.data(), false) == 1
+        && countSolutions(s, 2, kUniqueNodes) == 1) {
+      g->givens[cell] = 0;
+      --left;
+    } else {
+      board[cell] = g->givens[cell];
+    }
+  }
+  g->aboveFill = left > givens;
+}
+
+void generate(const GenOptions& options, uint64_t seed, GenInstance* g) {
+  const int n = options.order * options.order;
+  const int cells = n * n;
+  // exactly round(fill% of the cells) givens
+  const int givens = static_cast<int>((static_cast<long long>(cells)
+        * options.fill + 50) / 100);
+  RandomEngine rng(seed);
+  bool ok = false;
+  for (int a = 0; options.randomGrid && !ok && a < kGridAttempts; ++a) {
+    ok = randomGrid(options.order, &rng, &g->givens);
+  }
+  g->pattern = options.randomGrid && !ok;
+  if (!ok) patternGrid(options.order, &g->givens);
+  transformGrid(options.order, &rng, &g->givens);
+  g->aboveFill = false;
+  if (options.unique) {
+    removeUnique(options.order, givens, &rng, g);
+    return;
+  }
+  // pick which cells keep their value with a partial shuffle of the cell
+  // indexes
+  std::vector<int> picks(cells);
+  TBoardMask given(cells, 0);
+  for (int k = 0; k < cells; ++k) picks[k] = k;
+  for (int k = 0; k < givens; ++k) {
+    std::swap(picks[k], picks[k + rng.below(cells - k)]);
+    given[picks[k]] = 1;
+  }
+  for (int k = 0; k < cells; ++k) {
+    if (!given[k]) g->givens[k] = 0;
+  }
+}
+
+void writeText(FILE* out, int order, const TBoard& givens) {
+  const int n = order * order;
+  fprintf(out, "%d\n", order);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      fprintf(out, "%d\t", givens[i*n + j] ? givens[i*n + j] : -1);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+}  // namespace
+
+// Exit values: 0 ok, 1 can't create or write the output file, 4 invalid
+// argument, 5 invalid value.
+int main(int argc, char* argv[]) {
+  GenOptions options;
+  unsigned int seed = 24;
+  long count = 1;
+  int threads = 0;
+  int grid = -1;  // -1 default, 0 pattern, 1 random
+  bool corpus = false;
+  const char* outputFilename = NULL;
+  FILE* out = stdout;
+  CorpusWriter writer;
+
+  if (argc < 3) {
+    printf("\nUsage: gen <order> <fill %%> [-rs <seed>] [-o <file>]"
+        " [-count <N>]\n           [-threads <N>] [-grid random|pattern]"
+        " [-unique] [-corpus]\n");
+    printf("Writes random solvable instances with 'fill %%' of the cells"
+        " given.\n");
+    printf("  -count <N>   : instances to write. Default: 1\n");
+    printf("  -threads <N> : worker threads. Default: one per core\n");
+    printf("  -grid <G>    : complete grids from the exact engine (random,"
+        " orders up to 8)\n                 or from a fixed pattern. Default:"
+        " random up to order 6\n");
+    printf("  -unique      : keep givens needed for a unique solution"
+        " (orders up to 8)\n");
+    printf("  -corpus      : write a binary corpus to the -o file\n\n");
+    return 4;
+  }
+  options.order = atoi(argv[1]);
+  options.fill = atoi(argv[2]);
+  options.unique = false;
+  if (options.order < 1 || options.order >= 50 || options.fill < 0
+      || options.fill > 100) {
+    printf("\nInvalid order (1..49) or fill (0..100).\n");
+    return 5;
+  }
+  for (int i = 3; i < argc; ++i) {
+    std::string str = argv[i];
+    if (str == "-rs" && i+1 < argc) {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else if (str == "-o" && i+1 < argc) {
+      outputFilename = argv[++i];
+    } else if (str == "-count" && i+1 < argc) {
+      count = atol(argv[++i]);
+    } else if (str == "-threads" && i+1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (str == "-grid" && i+1 < argc) {
+      std::string name = argv[++i];
+      if (name != "random" && name != "pattern") {
+        printf("\nUnknown grid \"%s\" (random or pattern)\n", name.c_str());
+        return 5;
+      }
+      grid = name == "random" ? 1 : 0;
+    } else if (str == "-unique") {
+      options.unique = true;
+    } else if (str == "-corpus") {
+      corpus = true;
+    } else {
+      printf("\nUnknown argument #%d \"%s\"\n", i, argv[i]);
+      return 4;
+    }
+  }
+  if (count < 1) {
+    printf("\nInvalid count (1 or more).\n");
+    return 5;
+  }
+  if (options.order > 8 && (grid == 1 || options.unique)) {
+    printf("\n-grid random and -unique need the exact engine (orders up to"
+        " 8).\n");
+    return 5;
+  }
+  if (corpus && outputFilename == NULL) {
+    printf("\n-corpus needs an output file (-o).\n");
+    return 4;
+  }
+  options.randomGrid = grid == 1 || (grid == -1 && options.order <= 6);
+
+  if (corpus) {
+    if (!writer.open(outputFilename)) {
+      printf("\nCouldn't create output file \"%s\"\n", outputFilename);
+      return 1;
+    }
+  } else if (outputFilename != NULL) {
+    out = fopen(outputFilename, "w");
+    if (out == NULL) {
+      printf("\nCouldn't create output file \"%s\"\n", outputFilename);
+      return 1;
+    }
+  }
+
+  // generate in blocks, each written in order before the next starts
+  Clock::time_point begin = Clock::now();
+  ThreadPool pool(count == 1 ? 1 : threads);
+  const long block = std::min<long>(count, kBlockPerThread * pool.size());
+  std::vector<GenInstance> instances(block);
+  long aboveFill = 0, patterns = 0;
+  bool ok = true;
+  for (long first = 0; first < count; first += block) {
+    const long size = std::min(block, count - first);
+    for (long k = 0; k < size; ++k) {
+      const uint64_t instanceSeed =
+        (static_cast<uint64_t>(first + k) << 32) | seed;
+      GenInstance* g = &instances[k];
+      pool.submit([&options, instanceSeed, g] {
+        generate(options, instanceSeed, g);
+      });
+    }
+    pool.wait();
+    for (long k = 0; k < size; ++k) {
+      if (instances[k].aboveFill) ++aboveFill;
+      if (instances[k].pattern) ++patterns;
+      if (corpus) {
+        ok = writer.add(options.order, instances[k].givens.data()) && ok;
+      } else {
+        writeText(out, options.order, instances[k].givens);
+      }
+    }
+  }
+  if (corpus) {
+    ok = writer.close() && ok;
+  } else if (out != stdout) {
+    ok = fclose(out) == 0 && ok;
+  }
+  if (!ok) {
+    printf("\nCouldn't write output file \"%s\"\n", outputFilename);
+    return 1;
+  }
+
+  if (outputFilename != NULL) {
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    printf("%ld instances of order %d, %d%% given, in %.2fs (%.1f/s)\n",
+        count, options.order, options.fill, elapsed.count(),
+        count / std::max(elapsed.count(), 1e-9));
+    if (patterns > 0) {
+      printf("%ld from the pattern grid (random grid out of budget)\n",
+          patterns);
+    }
+    if (aboveFill > 0) {
+      printf("%ld above %d%% given (no more givens to remove keeping the"
+          " solution unique)\n", aboveFill, options.fill);
+    }
+  }
+  return 0;
+}
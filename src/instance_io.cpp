@@ -0,0 +1,226 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <instance_io.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kCorpusMagic[8] = { 'S', 'U', 'D', 'O', 'K', 'U', 'C', '1' };
+
+inline uint64_t alignTo8(uint64_t x) { return (x + 7) & ~7ULL; }
+
+// Bytes of a record (header plus padded cells) of the given order.
+inline uint64_t recordSize(int order) {
+  const uint64_t n = order * order;
+  return 8 + alignTo8(n * n * (n < 256 ? 1 : 2));
+}
+
+}  // namespace
+
+// ***************
+// * MappedFile  *
+// ***************
+
+MappedFile::MappedFile() : _data(NULL), _size(0), _mapped(false) {}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+bool MappedFile::open(const char* filename) {
+  struct stat info;
+  int fd;
+  close();
+  fd = ::open(filename, O_RDONLY);
+  if (fd < 0) return false;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void* p = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, info.st_size, MADV_SEQUENTIAL);
+      _data = static_cast<const char*>(p);
+      _size = info.st_size;
+      _mapped = true;
+      ::close(fd);
+      return true;
+    }
+  }
+  // not mappable: read it all
+  char chunk[65536];
+  ssize_t got;
+  while ((got = read(fd, chunk, sizeof(chunk))) > 0) {
+    _buffer.insert(_buffer.end(), chunk, chunk + got);
+  }
+  ::close(fd);
+  if (got < 0) {
+    _buffer.clear();
+    return false;
+  }
+  _data = _buffer.empty() ? NULL : &_buffer[0];
+  _size = _buffer.size();
+  return true;
+}
+
+void MappedFile::close() {
+  if (_mapped) munmap(const_cast<char*>(_data), _size);
+  std::vector<char>().swap(_buffer);
+  _data = NULL;
+  _size = 0;
+  _mapped = false;
+}
+
+// **********
+// * Corpus *
+// **********
+
+bool Corpus::isCorpus(const char* data, size_t size) {
+  return size >= sizeof(CorpusHeader)
+    && memcmp(data, kCorpusMagic, sizeof(kCorpusMagic)) == 0;
+}
+
+bool Corpus::open(const MappedFile& file) {
+  CorpusHeader header;
+  _data = file.data();
+  _size = file.size();
+  _count = 0;
+  _index = NULL;
+  if (!isCorpus(_data, _size)) return false;
+  memcpy(&header, _data, sizeof(header));
+  if (header.indexOffset % 8 != 0 || header.indexOffset > _size
+      || (_size - header.indexOffset) / 8 < header.count) {
+    return false;
+  }
+  _count = header.count;
+  _index = reinterpret_cast<const uint64_t*>(_data + header.indexOffset);
+  return true;
+}
+
+int Corpus::load(long k, Sudoku* s, bool checkValidity) const {
+  uint16_t order, cellBytes;
+  if (k < 0 || k >= _count) return 0;
+  const uint64_t offset = _index[k];
+  if (offset % 8 != 0 || offset + 8 > _size) return 0;
+  memcpy(&order, _data + offset, 2);
+  memcpy(&cellBytes, _data + offset + 2, 2);
+  if (order < 1 || order >= 50 || offset + recordSize(order) > _size
+      || cellBytes != (order*order < 256 ? 1 : 2)) {
+    return 0;
+  }
+  return s->loadPacked(order, _data + offset + 8, cellBytes, checkValidity);
+}
+
+// ****************
+// * CorpusWriter *
+// ****************
+
+CorpusWriter::CorpusWriter() : _file(NULL), _offset(0), _ok(false) {}
+
+CorpusWriter::~CorpusWriter() {
+  if (_file != NULL) close();
+}
+
+bool CorpusWriter::open(const char* filename) {
+  CorpusHeader header;
+  _file = fopen(filename, "wb");
+  if (_file == NULL) return false;
+  memset(&header, 0, sizeof(header));
+  _index.clear();
+  _offset = sizeof(header);
+  _ok = fwrite(&header, sizeof(header), 1, _file) == 1;
+  return _ok;
+}
+
+bool CorpusWriter::add(int order, const TCell* givens) {
+  const int n = order * order;
+  const int cellBytes = n < 256 ? 1 : 2;
+  const uint16_t fields[2] = { static_cast<uint16_t>(order),
+    static_cast<uint16_t>(cellBytes) };
+  if (_file == NULL || order < 1 || order >= 50) return false;
+  _record.assign(recordSize(order), 0);
+  memcpy(&_record[0], fields, sizeof(fields));
+  for (int k = 0; k < n*n; ++k) {
+    if (cellBytes == 1) {
+      _record[8 + k] = static_cast<uint8_t>(givens[k]);
+    } else {
+      memcpy(&_record[8 + 2*k], &givens[k], 2);
+    }
+  }
+  _index.push_back(_offset);
+  _offset += _record.size();
+  _ok = _ok && fwrite(&_record[0], _record.size(), 1, _file) == 1;
+  return _ok;
+}
+
+bool CorpusWriter::close() {
+  CorpusHeader header;
+  if (_file == NULL) return false;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCorpusMagic, sizeof(kCorpusMagic));
+  header.count = _index.size();
+  header.indexOffset = _offset;
+  if (!_index.empty()) {
+    _ok = _ok && fwrite(&_index[0], 8, _index.size(), _file) == _index.size();
+  }
+  _ok = _ok && fseek(_file, 0, SEEK_SET) == 0
+    && fwrite(&header, sizeof(header), 1, _file) == 1;
+  _ok = fclose(_file) == 0 && _ok;
+  _file = NULL;
+  return _ok;
+}
+
+// ***************
+// * Corpus dirs *
+// ***************
+
+std::vector<std::string> corpusFiles(const char* dir) {
+  std::vector<std::string> files;
+  DIR* d = opendir(dir);
+  if (d == NULL) return files;
+  struct dirent* entry;
+  while ((entry = readdir(d)) != NULL) {
+    int order, fill;
+    if (parseCorpusName(entry->d_name, &order, &fill)) {
+      files.push_back(std::string(dir) + "/" + entry->d_name);
+    }
+  }
+  closedir(d);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+bool parseCorpusName(const std::string& filename, int* order, int* fill) {
+  size_t slash = filename.find_last_of('/');
+  std::string name = slash == std::string::npos ? filename
+    : filename.substr(slash + 1);
+  char extra;
+  return sscanf(name.c_str(), "%d_%d%c", order, fill, &extra) == 2;  // NOLINT
+}
@@ -0,0 +1,488 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <lockstep.h>
+#include <rng.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SUDOKU_AVX2_DISPATCH
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const int kLanes = kLockstepLanes;
+const int kN = 9;                   // order 3
+const int kCells = kN * kN;
+const int kMaxMoves = kN * 36;      // every pair of cells of every square
+const int kLine = 16;               // value slots per row/column in the tables
+const int kDeltas = Sudoku::kMaxSwapDelta + 1;
+const int kClockCheckSteps = 512;   // steps between looks at the clock
+
+// Everything a step touches, lane by lane: entry x of lane l is at
+// x*kLanes + l. 32 bits entries, which is what the gathers load.
+struct Lanes {
+  int32_t board[kCells * kLanes];
+  // rowCount[(i*kLine + v)*kLanes + l]: how many v's row i has in lane l.
+  int32_t rowCount[kN * kLine * kLanes];
+  int32_t colCount[kN * kLine * kLanes];
+  // Moves packed as a | b << 7 | row(a) << 14 | col(a) << 18 | row(b) << 22
+  // | col(b) << 26, where a and b are cells (i*9 + j) of the same square.
+  int32_t moves[kMaxMoves * kLanes];
+  int32_t nMoves[kLanes];             // 0: the lane makes no proposals
+  uint32_t threshold[kDeltas * kLanes];   // see Sudoku::buildAcceptTable
+  uint32_t rng[4 * kLanes];           // xoshiro128** state
+};
+
+// What a step hands to applyMoves(), for the lanes that accepted.
+struct Step {
+  int32_t move[kLanes];
+  int32_t delta[kLanes];
+};
+
+// The per-lane bookkeeping that isn't part of the step.
+struct Lane {
+  bool          busy;
+  LockstepJob   job;
+  SAResult      result;
+  Clock::time_point begin;
+  int           cost;
+  int           solvedAt;     // step of the stage that reached cost 0 (or -1)
+  StageSchedule schedule;
+  int32_t       best[kCells];
+};
+
+inline int moveField(int32_t move, int shift, int bits) {
+  return (move >> shift) & ((1 << bits) - 1);
+}
+
+// xoshiro128** (Blackman & Vigna, 2018) on lane l.
+inline uint32_t rotl32(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+inline uint32_t nextRandom(uint32_t* s, int l) {
+  uint32_t* s0 = s + l;
+  uint32_t* s1 = s + kLanes + l;
+  uint32_t* s2 = s + 2*kLanes + l;
+  uint32_t* s3 = s + 3*kLanes + l;
+  const uint32_t result = rotl32(*s1 * 5, 7) * 9;
+  const uint32_t t = *s1 << 9;
+  *s2 ^= *s0;
+  *s3 ^= *s1;
+  *s1 ^= *s2;
+  *s0 ^= *s3;
+  *s2 ^= t;
+  *s3 = rotl32(*s3, 11);
+  return result;
+}
+
+// One proposal in every lane. Returns the mask of the lanes that accepted
+// theirs, with the moves and deltas in 'out'. Every lane draws two numbers,
+// busy or not, so the lanes never depend on each other.
+int stepScalar(Lanes* lanes, Step* out) {
+  int accepted = 0;
+  for (int l = 0; l < kLanes; ++l) {
+    const uint32_t pick = nextRandom(lanes->rng, l);
+    const uint32_t coin = nextRandom(lanes->rng, l);
+    const int32_t nMoves = lanes->nMoves[l];
+    if (nMoves == 0) continue;
+    const int32_t move = lanes->moves[
+      ((pick >> 16) * static_cast<uint32_t>(nMoves) >> 16) * kLanes + l];
+    const int a = moveField(move, 0, 7), b = moveField(move, 7, 7);
+    const int ra = moveField(move, 14, 4), ca = moveField(move, 18, 4);
+    const int rb = moveField(move, 22, 4), cb = moveField(move, 26, 4);
+    const int va = lanes->board[a*kLanes + l];
+    const int vb = lanes->board[b*kLanes + l];
+    int delta = 0;
+    // same rule as Sudoku::swapDelta
+    if (ra != rb) {
+      const int32_t* r1 = lanes->rowCount + ra*kLine*kLanes + l;
+      const int32_t* r2 = lanes->rowCount + rb*kLine*kLanes + l;
+      delta += (r1[va*kLanes] > 1 ? -1 : 0) + (r1[vb*kLanes] > 0 ? 1 : 0)
+             + (r2[vb*kLanes] > 1 ? -1 : 0) + (r2[va*kLanes] > 0 ? 1 : 0);
+    }
+    if (ca != cb) {
+      const int32_t* c1 = lanes->colCount + ca*kLine*kLanes + l;
+      const int32_t* c2 = lanes->colCount + cb*kLine*kLanes + l;
+      delta += (c1[va*kLanes] > 1 ? -1 : 0) + (c1[vb*kLanes] > 0 ? 1 : 0)
+             + (c2[vb*kLanes] > 1 ? -1 : 0) + (c2[va*kLanes] > 0 ? 1 : 0);
+    }
+    if (delta <= 0 || coin < lanes->threshold[delta*kLanes + l]) {
+      accepted |= 1 << l;
+      out->move[l] = move;
+      out->delta[l] = delta;
+    }
+  }
+  return accepted;
+}
+
+#ifdef SUDOKU_AVX2_DISPATCH
+__attribute__((target("avx2")))
+inline __m256i rotlAvx2(__m256i x, int k) {
+  return _mm256_or_si256(_mm256_slli_epi32(x, k), _mm256_srli_epi32(x, 32 - k));
+}
+
+__attribute__((target("avx2")))
+inline __m256i nextRandomAvx2(uint32_t* s) {
+  __m256i* p = reinterpret_cast<__m256i*>(s);
+  __m256i s0 = _mm256_loadu_si256(p), s1 = _mm256_loadu_si256(p + 1);
+  __m256i s2 = _mm256_loadu_si256(p + 2), s3 = _mm256_loadu_si256(p + 3);
+  __m256i x = _mm256_add_epi32(_mm256_slli_epi32(s1, 2), s1);   // s1 * 5
+  x = rotlAvx2(x, 7);
+  const __m256i result = _mm256_add_epi32(_mm256_slli_epi32(x, 3), x);
+  const __m256i t = _mm256_slli_epi32(s1, 9);
+  s2 = _mm256_xor_si256(s2, s0);
+  s3 = _mm256_xor_si256(s3, s1);
+  s1 = _mm256_xor_si256(s1, s2);
+  s0 = _mm256_xor_si256(s0, s3);
+  s2 = _mm256_xor_si256(s2, t);
+  s3 = rotlAvx2(s3, 11);
+  _mm256_storeu_si256(p, s0);
+  _mm256_storeu_si256(p + 1, s1);
+  _mm256_storeu_si256(p + 2, s2);
+  _mm256_storeu_si256(p + 3, s3);
+  return result;
+}
+
+// Cost change of the two lines (rows or columns) a move touches: +1 for a
+// value entering a line that already has it, -1 for one leaving a line where
+// it repeats. The compares give -1 for true, hence saves - costs.
+__attribute__((target("avx2")))
+inline __m256i lineGain(const int32_t* count, __m256i line1, __m256i line2,
+    __m256i va, __m256i vb, __m256i lane) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  __m256i base1 = _mm256_or_si256(_mm256_slli_epi32(line1, 7), lane);
+  __m256i base2 = _mm256_or_si256(_mm256_slli_epi32(line2, 7), lane);
+  __m256i a3 = _mm256_slli_epi32(va, 3), b3 = _mm256_slli_epi32(vb, 3);
+  __m256i c1a = _mm256_i32gather_epi32(count, _mm256_or_si256(base1, a3), 4);
+  __m256i c1b = _mm256_i32gather_epi32(count, _mm256_or_si256(base1, b3), 4);
+  __m256i c2a = _mm256_i32gather_epi32(count, _mm256_or_si256(base2, a3), 4);
+  __m256i c2b = _mm256_i32gather_epi32(count, _mm256_or_si256(base2, b3), 4);
+  __m256i saves = _mm256_add_epi32(_mm256_cmpgt_epi32(c1a, one),
+      _mm256_cmpgt_epi32(c2b, one));
+  __m256i costs = _mm256_add_epi32(_mm256_cmpgt_epi32(c1b, zero),
+      _mm256_cmpgt_epi32(c2a, zero));
+  // lines shared by both cells don't change
+  return _mm256_andnot_si256(_mm256_cmpeq_epi32(line1, line2),
+      _mm256_sub_epi32(saves, costs));
+}
+
+// Same as stepScalar(), eight lanes at a time.
+__attribute__((target("avx2")))
+int stepAvx2(Lanes* lanes, Step* out) {
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i sign = _mm256_set1_epi32(0x80000000);
+  const __m256i mask4 = _mm256_set1_epi32(15), mask7 = _mm256_set1_epi32(127);
+  const __m256i pick = nextRandomAvx2(lanes->rng);
+  const __m256i coin = nextRandomAvx2(lanes->rng);
+  const __m256i nMoves = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(lanes->nMoves));
+  __m256i index = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_srli_epi32(pick, 16), nMoves), 16);
+  __m256i move = _mm256_i32gather_epi32(lanes->moves,
+      _mm256_or_si256(_mm256_slli_epi32(index, 3), lane), 4);
+  __m256i a = _mm256_and_si256(move, mask7);
+  __m256i b = _mm256_and_si256(_mm256_srli_epi32(move, 7), mask7);
+  __m256i ra = _mm256_and_si256(_mm256_srli_epi32(move, 14), mask4);
+  __m256i ca = _mm256_and_si256(_mm256_srli_epi32(move, 18), mask4);
+  __m256i rb = _mm256_and_si256(_mm256_srli_epi32(move, 22), mask4);
+  __m256i cb = _mm256_and_si256(_mm256_srli_epi32(move, 26), mask4);
+  __m256i va = _mm256_i32gather_epi32(lanes->board,
+      _mm256_or_si256(_mm256_slli_epi32(a, 3), lane), 4);
+  __m256i vb = _mm256_i32gather_epi32(lanes->board,
+      _mm256_or_si256(_mm256_slli_epi32(b, 3), lane), 4);
+  __m256i delta = _mm256_add_epi32(
+      lineGain(lanes->rowCount, ra, rb, va, vb, lane),
+      lineGain(lanes->colCount, ca, cb, va, vb, lane));
+  __m256i threshold = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(lanes->threshold),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_max_epi32(delta, zero), 3),
+        lane), 4);
+  // unsigned coin < threshold, by flipping the sign bits
+  __m256i accept = _mm256_or_si256(_mm256_cmpgt_epi32(one, delta),
+      _mm256_cmpgt_epi32(_mm256_xor_si256(threshold, sign),
+        _mm256_xor_si256(coin, sign)));
+  accept = _mm256_and_si256(accept, _mm256_cmpgt_epi32(nMoves, zero));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out->move), move);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out->delta), delta);
+  return _mm256_movemask_ps(_mm256_castsi256_ps(accept));
+}
+
+bool cpuHasAvx2() {
+  static const bool has = __builtin_cpu_supports("avx2");
+  return has;
+}
+#endif
+
+// Makes the accepted moves (AVX2 has no scatter, and few lanes accept late
+// in the search anyway). Lanes that get to cost 0 stop proposing.
+void applyMoves(Lanes* lanes, Lane* lane, const Step& step, int accepted,
+    int stepIndex) {
+  while (accepted != 0) {
+    const int l = __builtin_ctz(accepted);
+    accepted &= accepted - 1;
+    const int32_t move = step.move[l];
+    const int a = moveField(move, 0, 7), b = moveField(move, 7, 7);
+    const int ra = moveField(move, 14, 4), ca = moveField(move, 18, 4);
+    const int rb = moveField(move, 22, 4), cb = moveField(move, 26, 4);
+    int32_t* board = lanes->board;
+    const int va = board[a*kLanes + l], vb = board[b*kLanes + l];
+    board[a*kLanes + l] = vb;
+    board[b*kLanes + l] = va;
+    if (ra != rb) {
+      int32_t* r1 = lanes->rowCount + ra*kLine*kLanes + l;
+      int32_t* r2 = lanes->rowCount + rb*kLine*kLanes + l;
+      --r1[va*kLanes];
+      ++r1[vb*kLanes];
+      --r2[vb*kLanes];
+      ++r2[va*kLanes];
+    }
+    if (ca != cb) {
+      int32_t* c1 = lanes->colCount + ca*kLine*kLanes + l;
+      int32_t* c2 = lanes->colCount + cb*kLine*kLanes + l;
+      --c1[va*kLanes];
+      ++c1[vb*kLanes];
+      --c2[vb*kLanes];
+      ++c2[va*kLanes];
+    }
+    ++lane[l].result.accepted;
+    lane[l].cost += step.delta[l];
+    if (lane[l].cost == 0) {
+      lanes->nMoves[l] = 0;
+      lane[l].solvedAt = stepIndex;
+    }
+  }
+}
+
+void buildThresholds(Lanes* lanes, int l, float temperature) {
+  // exp(-d/T) for every d from a single exp()
+  const double base = exp(-1 / temperature);
+  double p = 1;
+  for (int d = 0; d < kDeltas; ++d, p *= base) {
+    lanes->threshold[d*kLanes + l] = static_cast<uint32_t>(
+        std::min(p * 4294967296.0, 4294967295.0));
+  }
+}
+
+// Copies a board into lane l and rebuilds its occurrence tables. Returns its
+// cost.
+int loadBoard(Lanes* lanes, int l, const TBoard& board) {
+  int cost = 0;
+  for (int i = 0; i < kN; ++i) {
+    for (int v = 0; v < kLine; ++v) {
+      lanes->rowCount[(i*kLine + v)*kLanes + l] = 0;
+      lanes->colCount[(i*kLine + v)*kLanes + l] = 0;
+    }
+  }
+  for (int c = 0; c < kCells; ++c) {
+    const int v = board[c];
+    lanes->board[c*kLanes + l] = v;
+    ++lanes->rowCount[((c / kN)*kLine + v)*kLanes + l];
+    ++lanes->colCount[((c % kN)*kLine + v)*kLanes + l];
+  }
+  for (int i = 0; i < kN; ++i) {
+    for (int v = 1; v <= kN; ++v) {
+      cost += std::max(lanes->rowCount[(i*kLine + v)*kLanes + l] - 1, 0);
+      cost += std::max(lanes->colCount[(i*kLine + v)*kLanes + l] - 1, 0);
+    }
+  }
+  return cost;
+}
+
+// Puts a new puzzle in lane l. Returns false if it's already done (nothing
+// to move, or solved by presolve alone), in which case it was reported.
+bool startLane(Lanes* lanes, Lane* lane, int l, const LockstepJob& job,
+    const SAParams& params, const LockstepSink& done) {
+  Lane& ln = lane[l];
+  Sudoku* s = job.sudoku;
+  const TBoard& givens = s->givens();
+  SplitMix64 seeder(job.seed);
+
+  ln.begin = Clock::now();
+  ln.job = job;
+  ln.result.status = kNoMoves;
+  ln.result.proposals = ln.result.accepted = ln.result.uphillAccepted = 0;
+  ln.result.reheats = 0;
+  ln.result.cpuSeconds = 0;
+  ln.result.initialSolution = s->startSearch(job.seed);
+  ln.cost = loadBoard(lanes, l, s->board());
+  ln.solvedAt = -1;
+  ln.schedule.start(params.initialTemp, ln.cost);
+  for (int c = 0; c < kCells; ++c) ln.best[c] = lanes->board[c*kLanes + l];
+  for (int k = 0; k < 4; k += 2) {
+    uint64_t x = seeder.next64();
+    lanes->rng[k*kLanes + l] = static_cast<uint32_t>(x);
+    lanes->rng[(k+1)*kLanes + l] = static_cast<uint32_t>(x >> 32);
+  }
+  buildThresholds(lanes, l, ln.schedule.temperature);
+
+  int nMoves = 0;
+  for (int sq = 0; sq < kN; ++sq) {
+    int cells[kN], k = 0;
+    for (int t = 0; t < kN; ++t) {
+      const int c = ((sq / 3)*3 + t / 3)*kN + (sq % 3)*3 + t % 3;
+      if (givens[c] == 0) cells[k++] = c;
+    }
+    for (int x = 0; x < k; ++x) {
+      for (int y = x + 1; y < k; ++y) {
+        const int a = cells[x], b = cells[y];
+        lanes->moves[nMoves++ * kLanes + l] = a | b << 7 | (a / kN) << 14
+          | (a % kN) << 18 | (b / kN) << 22 | (b % kN) << 26;
+      }
+    }
+  }
+  lanes->nMoves[l] = ln.cost == 0 ? 0 : nMoves;
+  ln.busy = lanes->nMoves[l] > 0;
+  if (!ln.busy) {
+    ln.result.status = ln.cost == 0 ? kSolved : kNoMoves;
+    ln.result.finalSolution = ln.cost;
+    ln.result.seconds = 0;
+    done(job, ln.result);
+  }
+  return ln.busy;
+}
+
+// Hands the best board of lane l back to its Sudoku and reports it.
+void finishLane(Lanes* lanes, Lane* lane, int l, SAStatus status,
+    const LockstepSink& done) {
+  Lane& ln = lane[l];
+  TBoard board = ln.job.sudoku->board();
+  const bool current = ln.cost <= ln.schedule.bestCost;
+  for (int c = 0; c < kCells; ++c) {
+    board[c] = current ? lanes->board[c*kLanes + l] : ln.best[c];
+  }
+  ln.result.status = status;
+  ln.result.finalSolution = ln.job.sudoku->setBoard(board);
+  std::chrono::duration<double> elapsed = Clock::now() - ln.begin;
+  ln.result.seconds = elapsed.count();
+  lanes->nMoves[l] = 0;
+  ln.busy = false;
+  done(ln.job, ln.result);
+}
+
+}  // namespace
+
+bool lockstepUsesAvx2() {
+#ifdef SUDOKU_AVX2_DISPATCH
+  return cpuHasAvx2();
+#else
+  return false;
+#endif
+}
+
+void solveLockstep(const SAParams& params, const LockstepSource& next,
+    const LockstepSink& done) {
+  Lanes lanes;
+  Lane lane[kLanes];
+  Step step;
+  int busy = 0, sinceClockCheck = 0;
+  const int stagesLength = params.stagesLength;
+  const bool avx2 = lockstepUsesAvx2();
+
+  memset(&lanes, 0, sizeof(lanes));
+  for (int l = 0; l < kLanes; ++l) lane[l].busy = false;
+
+  for (;;) {
+    // fill the idle lanes, stopping at the first time the source runs dry
+    bool more = true;
+    LockstepJob job;
+    for (int l = 0; l < kLanes && more; ++l) {
+      while (!lane[l].busy && (more = next(busy == 0, &job))) {
+        if (startLane(&lanes, lane, l, job, params, done)) ++busy;
+      }
+    }
+    if (busy == 0) return;  // the source ran dry with every lane idle
+
+    // a temperature stage in every lane
+    for (int t = 0; t < stagesLength; ++t) {
+      int accepted;
+#ifdef SUDOKU_AVX2_DISPATCH
+      accepted = avx2 ? stepAvx2(&lanes, &step) : stepScalar(&lanes, &step);
+#else
+      accepted = stepScalar(&lanes, &step);
+#endif
+      if (accepted != 0) applyMoves(&lanes, lane, step, accepted, t);
+    }
+    sinceClockCheck += stagesLength;
+    bool checkClock = params.maxSeconds > 0
+      && sinceClockCheck >= kClockCheckSteps;
+    Clock::time_point now;
+    if (checkClock) {
+      now = Clock::now();
+      sinceClockCheck = 0;
+    }
+
+    // the end of stage part of Sudoku::solve() (StageSchedule), lane by lane
+    for (int l = 0; l < kLanes; ++l) {
+      Lane& ln = lane[l];
+      if (!ln.busy) continue;
+      if (ln.solvedAt >= 0) {
+        ln.result.proposals += ln.solvedAt + 1;
+        finishLane(&lanes, lane, l, kSolved, done);
+        --busy;
+        continue;
+      }
+      ln.result.proposals += stagesLength;
+      switch (ln.schedule.endStage(params, params.alpha, ln.cost)) {
+        case kStageNewBest:
+          for (int c = 0; c < kCells; ++c) {
+            ln.best[c] = lanes.board[c*kLanes + l];
+          }
+          break;
+        case kStageRestart:
+          ln.job.sudoku->randomizeFreeCells();
+          ln.cost = loadBoard(&lanes, l, ln.job.sudoku->board());
+          // fall through
+        case kStageReheat:
+          ++ln.result.reheats;
+          break;
+        case kStageGoOn:
+          break;
+      }
+      buildThresholds(&lanes, l, ln.schedule.temperature);
+
+      if (params.maxProposals > 0
+          && ln.result.proposals >= params.maxProposals) {
+        finishLane(&lanes, lane, l, kOutOfProposals, done);
+        --busy;
+      } else if (checkClock) {
+        std::chrono::duration<double> elapsed = now - ln.begin;
+        if (elapsed.count() >= params.maxSeconds) {
+          finishLane(&lanes, lane, l, kOutOfTime, done);
+          --busy;
+        }
+      }
+    }
+  }
+}
@@ -25,9 +25,109 @@
  */
 
 #include <sudoku.h>
+#include <portfolio.h>
+#include <tempering.h>
+#include <batch.h>
+#include <lockstep.h>
+#include <telemetry.h>
+#include <instance_io.h>
+#include <exact.h>
+#include <solution_cache.h>
+#include <checkpoint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <string>
+#include <cctype>
 #include <cstdio>
+#include <vector>
+
+// Raised by SIGINT and SIGTERM while checkpointing: the search stops at the
+// end of the stage and leaves a checkpoint to resume from.
+std::atomic<bool> stopRequested(false);
+void requestStop(int) {
+  stopRequested = true;
+}
+
+// Batch mode (-batch): solves every instance in the input stream. Settings
+// left unset (<= 0) in params take their per-instance defaults.
+int runBatch(const char* instanceFilename, const char* outputFilename,
+    std::ofstream* ofile, const SAParams& params, int threads, bool presolve,
+    bool lockstep, SolutionCache* cache) {
+  BatchOptions options;
+  BatchSummary summary;
+  FILE* fout;
+
+  options.params = params;
+  options.threads = threads;
+  options.presolve = presolve;
+  options.cache = cache;
+  options.lockstep = lockstep;
+
+  ofile->close();
+  fout = fopen(outputFilename, "w");
+  if (fout == NULL) {
+    printf("\nCouldn't create output file \"%s\"\n\n", outputFilename);
+    return 1;
+  }
+  printf("\nSolving batch from %s (seeds from %u)...\n",
+      instanceFilename == NULL ? "stdin" : instanceFilename,
+      options.params.randomSeed);
+  if (lockstep) {
+    printf("Order 3 puzzles annealed %d at a time (%s)\n", kLockstepLanes,
+        lockstepUsesAvx2() ? "AVX2" : "scalar");
+  }
+
+  if (instanceFilename == NULL) {
+    solveBatch(stdin, fout, options, &summary);
+  } else {
+    // files are mapped and parsed in place; binary corpora are read as is
+    MappedFile file;
+    Corpus corpus;
+    if (!file.open(instanceFilename)) {
+      printf("\nCouldn't open input file \"%s\"\n\n", instanceFilename);
+      fclose(fout);
+      return 3;
+    }
+    if (Corpus::isCorpus(file.data(), file.size())) {
+      if (!corpus.open(file)) {
+        printf("\nInvalid corpus file \"%s\"\n\n", instanceFilename);
+        fclose(fout);
+        return 6;
+      }
+      long k = 0;
+      solveBatch([&](Sudoku* s) {
+        return k < corpus.size() ? corpus.load(k++, s) : kEndOfInput;
+      }, fout, options, &summary);
+    } else {
+      const char* cursor = file.data();
+      const char* end = file.data() + file.size();
+      solveBatch([&](Sudoku* s) {
+        while (cursor < end && isspace(*cursor)) ++cursor;
+        if (cursor == end) return kEndOfInput;
+        return s->loadInstanceText(cursor, end, &cursor, true);
+      }, fout, options, &summary);
+    }
+  }
+  fclose(fout);
+
+  printf("Batch info:\n");
+  printf("  Puzzles:\t\t%ld\n", summary.puzzles);
+  printf("  Solved:\t\t%ld\n", summary.solved);
+  if (cache != NULL) {
+    printf("  From cache:\t\t%ld (%zu entries now)\n", summary.cached,
+        cache->size());
+  }
+  printf("  Best found:\t\t%ld (budget ran out)\n", summary.failed);
+  printf("  Invalid:\t\t%ld\n", summary.invalid);
+  printf("  Runtime:\t\t~%fs\n", summary.seconds);
+  printf("  Throughput:\t\t%f puzzles/s\n",
+      summary.seconds > 0 ? summary.puzzles / summary.seconds : 0);
+  printf("Results written to file \"%s\".\n", outputFilename);
+  return 0;
+}
 
 // Not sure if someone will ever use this, but the possible exit values are:
 // -1: no parameters given. will display usage example.
@@ -39,14 +139,37 @@
 //  5: invalid value for some valid option
 //  6: something went wrong while reading instance
 //  7: instance given is not solvable
+//  8: a budget (-tl/-il) ran out before solving it, or it was interrupted
+//     (with -checkpoint); the best board found was dumped
+//  9: the solution found failed the final verification (a bug!)
 int main(int argc, char *argv[]) {
   // arguments parsing
-  float initialTemp, tempDecrease, tempStagesF, randomSeedF;
-  int tempStages;
+  float initialTemp, tempDecrease, tempStagesF, randomSeedF, threadsF;
+  float replicasF, exchangeF, minTempF, maxTempF;
+  float timeLimitF, proposalsLimitF, stallF;
+  float handoffF, exactFreeF, cacheF, biasF, rfBelowF, checkpointEveryF;
+  float traceEveryF;
+  std::string engine = "sa";
+  std::string moves = "random";
+  bool restart = false;
+  bool adaptive = false;
+  bool rejectionFree = false;
+  SAParams params;
+  int tempStages, threads, replicas = 1, exchangeInterval = 1;
   unsigned int randomSeed;
   float *fptr;
   char *instanceFilename, *outputFilename;
+  const char* traceFilename = NULL;
+  const char* cacheFilename = NULL;
+  const char* checkpointFilename = NULL;
+  const char* resumeFilename = NULL;
+  TraceWriter trace;
+  CheckpointWriter checkpoint;
   bool verbose = false;
+  bool batch = false;
+  bool lockstep = false;
+  bool presolve = true;
+  int presolved = 0;
   int firstOptionIndex;
 
   if  (argc <= 1) {
@@ -58,47 +181,140 @@ int main(int argc, char *argv[]) {
     printf("  -it <N> \t: Initial temperature. Default: instance order * 100\n"); // NOLINT
     printf("  -a  <N> \t: Temperature decrease in each stage. Default: 0.9\n");
     printf("  -sl <N> \t: Temperature stages length. Default: (instance order)^2\n"); // NOLINT
-    printf("  -rs <N> \t: Random seed. Default: [24]");
+    printf("  -adaptive \t: Adaptive schedule: -it/-sl default to values measured on the instance and\n");  // NOLINT
+    printf("                  the cooling speed follows the acceptance rate (-a is ignored)\n");  // NOLINT
+    printf("  -moves <M> \t: random (a random square) or conflict (mostly a cell whose value\n");  // NOLINT
+    printf("                  repeats in its row or column). Default: random\n");  // NOLINT
+    printf("  -bias <N> \t: With -moves conflict, share of the moves from a conflicting cell. Default: 0.3\n");  // NOLINT
+    printf("  -rejectionfree\t: Once a stage accepts few proposals (see -rfbelow), only make the\n");  // NOLINT
+    printf("                  accepted moves, drawn by their weight (n-fold way), until a reheat\n");  // NOLINT
+    printf("  -rfbelow <N> \t: With -rejectionfree, acceptance rate that starts it. Default: 0.01\n");  // NOLINT
+    printf("  -rs <N> \t: Random seed. Default: [24]\n");
+    printf("  -threads <N> \t: Race N annealers (seeds rs, rs+1, ...) and keep the first to solve it. Default: 1\n");  // NOLINT
+    printf("  -pt <K> \t: Use parallel tempering with K replicas instead of a single annealer\n");  // NOLINT
+    printf("  -ptx <N> \t: Parallel tempering: proposals between exchanges. Default: (instance order)^4\n");  // NOLINT
+    printf("  -ptmin <N> \t: Parallel tempering: lowest temperature. Default: 0.2\n");  // NOLINT
+    printf("  -ptmax <N> \t: Parallel tempering: highest temperature. Default: 2.0\n");  // NOLINT
+    printf("                  (with -pt, -threads sets the worker threads. Default: one per core)\n");  // NOLINT
+    printf("  -tl <N> \t: Time limit, in seconds. Default: none (-engine exact, or hybrid\n");  // NOLINT
+    printf("                  without -il: %g)\n", kExactDefaultSeconds);  // NOLINT
+    printf("  -il <N> \t: Limit of proposals (iterations). Default: none\n");
+    printf("  -stall <N> \t: Reheat after N stages without a new best solution (0: never). Default: 0\n");  // NOLINT
+    printf("  -restart \t: On stall, restart from a new random solution instead of only reheating (needs -stall)\n");  // NOLINT
+    printf("  -batch  \t: Solve every instance in the input (concatenated), one result line each\n");  // NOLINT
+    printf("                  (with -batch, -threads sets the worker threads. Default: one per core;\n");  // NOLINT
+    printf("                  without -tl/-il, each puzzle gets %lld * (instance order)^8 proposals)\n", kBatchProposalsPerN4);  // NOLINT
+    printf("  -lockstep \t: Batch: anneal order 3 puzzles %d at a time, lane by lane (SIMD);\n", kLockstepLanes);  // NOLINT
+    printf("                  fixed schedule with random moves only\n");  // NOLINT
+    printf("  -nopresolve \t: Skip constraint propagation before annealing\n");  // NOLINT
+    printf("  -engine <E> \t: sa (simulated annealing), exact (backtracking, orders up to 8)\n");  // NOLINT
+    printf("                  or hybrid (annealing, then exact from its board). Default: sa\n");  // NOLINT
+    printf("  -handoff <N> \t: Hybrid: cost at which annealing hands off. Default: instance order\n");  // NOLINT
+    printf("  -exactfree <N>\t: Hybrid: go exact first if at most N free cells. Default: half the cells\n");  // NOLINT
+    printf("  -cache <N> \t: Keep the solutions of up to N puzzles, by canonical form, and reuse\n");  // NOLINT
+    printf("                  them for equivalent ones (batch mode). Default: 10000 with -cachefile\n");  // NOLINT
+    printf("  -cachefile <F>\t: Back the cache with file F, kept across runs (also for a single puzzle)\n");  // NOLINT
+    printf("  -checkpoint <F>\t: Save the search to F every -ckevery seconds, and when a budget or\n");  // NOLINT
+    printf("                  SIGINT/SIGTERM stops it (single annealer only)\n");  // NOLINT
+    printf("  -ckevery <N> \t: Seconds between checkpoints. Default: 60\n");  // NOLINT
+    printf("  -resume <F> \t: Carry on from checkpoint F, with its settings, on the same instance\n");  // NOLINT
+    printf("                  (-tl/-il, if given, replace its budgets, which count the time before)\n");  // NOLINT
+    printf("  -trace <F> \t: Write per-stage counters to F (CSV if it ends in .csv, binary otherwise)\n");  // NOLINT
+    printf("  -traceevery <N>\t: Trace one stage in N, plus every new best. Default: 100\n");  // NOLINT
+    printf("                  (needs a build with telemetry: make TELEMETRY=1)\n");  // NOLINT
     printf("  -v      \t: Verbose switch. Will display input and output info to stdout");  // NOLINT
     printf("\n\n");
     return -1;
   }
 
-  // check if is possible to create the output file
-  std::ofstream ofile(argv[1]);
-  if (!ofile) {
-    printf("\nCouldn't create output file \"%s\"\n\n", argv[1]);
-    return 1;
-  }
   outputFilename = argv[1];
 
-  if (ftell(stdin) >= 0) {  // if there is something at stdin, will read from it
-    instanceFilename = '\0';
-    firstOptionIndex = 2;
-  } else {  // there is nothing at stdin, so we need some instance filename
-    if ( argc == 2 ) {
-      printf("\nMissing instance to solve.\n");
-      return 2;
-    } else {
-      // check instance file
-      std::ifstream ifile(argv[2]);
-      if (!ifile) {
-        printf("\nCouldn't open input file \"%s\"\n\n", argv[2]);
-        return 3;
-      }
-      instanceFilename = argv[2];
-      firstOptionIndex = 3;
+  // the instance comes from the file named right after the output one or,
+  // if the next argument is already an option, from stdin
+  if (argc > 2 && argv[2][0] != '-') {
+    std::ifstream ifile(argv[2]);
+    if (!ifile) {
+      printf("\nCouldn't open input file \"%s\"\n\n", argv[2]);
+      return 3;
     }
+    instanceFilename = argv[2];
+    firstOptionIndex = 3;
+  } else if (isatty(STDIN_FILENO)) {
+    printf("\nMissing instance to solve.\n");
+    return 2;
+  } else {
+    instanceFilename = NULL;
+    firstOptionIndex = 2;
   }
   // read the rest
   // ps.: i know it's ugly, but i was in a kind of hurry to get this done
-  initialTemp = tempDecrease = tempStagesF = randomSeedF = -1;
+  initialTemp = tempDecrease = tempStagesF = randomSeedF = threadsF = -1;
+  replicasF = exchangeF = minTempF = maxTempF = -1;
+  timeLimitF = proposalsLimitF = stallF = -1;
+  handoffF = exactFreeF = cacheF = biasF = rfBelowF = checkpointEveryF = -1;
+  traceEveryF = -1;
   std::string str;
   for (int i = firstOptionIndex; i < argc; ++i) {
     str = argv[i];
     if (str == "-v") {
       verbose = true;
       continue;
+    } else if (str == "-batch") {
+      batch = true;
+      continue;
+    } else if (str == "-lockstep") {
+      lockstep = true;
+      continue;
+    } else if (str == "-nopresolve") {
+      presolve = false;
+      continue;
+    } else if (str == "-restart") {
+      restart = true;
+      continue;
+    } else if (str == "-adaptive") {
+      adaptive = true;
+      continue;
+    } else if (str == "-rejectionfree") {
+      rejectionFree = true;
+      continue;
+    } else if (str == "-rfbelow") {
+      fptr = &rfBelowF;
+    } else if (str == "-trace") {
+      if (i+1 < argc) traceFilename = argv[++i];
+      continue;
+    } else if (str == "-checkpoint") {
+      if (i+1 < argc) checkpointFilename = argv[++i];
+      continue;
+    } else if (str == "-resume") {
+      if (i+1 < argc) resumeFilename = argv[++i];
+      continue;
+    } else if (str == "-ckevery") {
+      fptr = &checkpointEveryF;
+    } else if (str == "-traceevery") {
+      fptr = &traceEveryF;
+    } else if (str == "-cachefile") {
+      if (i+1 < argc) cacheFilename = argv[++i];
+      continue;
+    } else if (str == "-engine") {
+      if (i+1 < argc) engine = argv[++i];
+      continue;
+    } else if (str == "-moves") {
+      if (i+1 < argc) moves = argv[++i];
+      continue;
+    } else if (str == "-bias") {
+      fptr = &biasF;
+    } else if (str == "-cache") {
+      fptr = &cacheF;
+    } else if (str == "-handoff") {
+      fptr = &handoffF;
+    } else if (str == "-exactfree") {
+      fptr = &exactFreeF;
+    } else if (str == "-tl") {
+      fptr = &timeLimitF;
+    } else if (str == "-il") {
+      fptr = &proposalsLimitF;
+    } else if (str == "-stall") {
+      fptr = &stallF;
     } else if (str == "-it") {
       fptr = &initialTemp;
     } else if (str == "-alpha") {
@@ -107,6 +323,16 @@ int main(int argc, char *argv[]) {
       fptr = &tempStagesF;
     } else if (str == "-rs") {
       fptr = &randomSeedF;
+    } else if (str == "-threads") {
+      fptr = &threadsF;
+    } else if (str == "-pt") {
+      fptr = &replicasF;
+    } else if (str == "-ptx") {
+      fptr = &exchangeF;
+    } else if (str == "-ptmin") {
+      fptr = &minTempF;
+    } else if (str == "-ptmax") {
+      fptr = &maxTempF;
     } else {
       printf("\nUnknown argument #%d \"%s\"\n", i, argv[i]);
       return 4;
@@ -124,6 +350,96 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (engine != "sa" && engine != "exact" && engine != "hybrid") {
+    printf("Invalid value for \"-engine\" argument (\"%s\")\n",
+        engine.c_str());
+    return 5;
+  }
+  if (moves != "random" && moves != "conflict") {
+    printf("Invalid value for \"-moves\" argument (\"%s\")\n",
+        moves.c_str());
+    return 5;
+  }
+  if (biasF != -1 && (biasF < 0 || biasF > 1)) {
+    printf("Invalid value for \"-bias\" argument (%f)\n", biasF);
+    return 5;
+  }
+  if (engine != "sa" && (replicasF != -1 || threadsF > 1 || batch)) {
+    printf("\n-engine %s runs a single search (no -pt, -threads or -batch)\n",
+        engine.c_str());
+    return 5;
+  }
+  if (restart && stallF <= 0) {
+    printf("\n-restart needs -stall (stall handling is off by default)\n");
+    return 5;
+  }
+  if (batch && (replicasF != -1 || traceFilename != NULL)) {
+    printf("\n-batch anneals each instance on its own (no -pt or -trace)\n");
+    return 5;
+  }
+  if ((checkpointFilename != NULL || resumeFilename != NULL)
+      && (engine != "sa" || replicasF != -1 || threadsF > 1 || batch)) {
+    printf("\n-checkpoint and -resume only apply to a single annealer"
+        " (no -engine, -pt, -threads or -batch)\n");
+    return 5;
+  }
+  if (traceEveryF != -1 && traceEveryF < 1) {
+    printf("Invalid value for \"-traceevery\" argument (%f)\n", traceEveryF);
+    return 5;
+  }
+  if (checkpointEveryF != -1 && checkpointEveryF <= 0) {
+    printf("Invalid value for \"-ckevery\" argument (%f)\n",
+        checkpointEveryF);
+    return 5;
+  }
+
+  // check if is possible to create the output file (only now that the
+  // arguments are known to be fine)
+  std::ofstream ofile(outputFilename);
+  if (!ofile) {
+    printf("\nCouldn't create output file \"%s\"\n\n", outputFilename);
+    return 1;
+  }
+
+  // settings that don't depend on the instance
+  params.maxSeconds = timeLimitF == -1 ? 0 : timeLimitF;
+  params.maxProposals = proposalsLimitF == -1 ? 0
+    : static_cast<long long>(proposalsLimitF);
+  // the exact search has no proposals to count
+  if (params.maxSeconds <= 0 && (engine == "exact"
+      || (engine == "hybrid" && params.maxProposals <= 0))) {
+    params.maxSeconds = kExactDefaultSeconds;
+  }
+  params.stallStages = stallF == -1 ? 0 : static_cast<int>(stallF);
+  params.restart = restart;
+  params.adaptive = adaptive;
+  params.moves = moves == "conflict" ? kConflictMoves : kRandomMoves;
+  if (biasF != -1) params.conflictBias = biasF;
+  params.rejectionFree = rejectionFree;
+  if (rfBelowF != -1) params.rejectionFreeBelow = rfBelowF;
+
+  // the cache is only used with -cache or -cachefile
+  bool useCache = cacheF != -1 || cacheFilename != NULL;
+  if (useCache && cacheF != -1 && cacheF < 1) {
+    printf("\nInvalid cache size (%f)\n", cacheF);
+    return 5;
+  }
+  SolutionCache cache(cacheF == -1 ? 10000 : static_cast<size_t>(cacheF));
+  if (cacheFilename != NULL && !cache.open(cacheFilename)) {
+    printf("\nCouldn't open cache file \"%s\"\n", cacheFilename);
+    return 1;
+  }
+
+  if (batch) {
+    params.initialTemp = initialTemp;
+    params.alpha = tempDecrease == -1 ? 0.9 : tempDecrease;
+    params.stagesLength = static_cast<int>(tempStagesF);
+    params.randomSeed = randomSeedF == -1 ? 24
+      : static_cast<unsigned int>(randomSeedF);
+    return runBatch(instanceFilename, outputFilename, &ofile, params,
+        static_cast<int>(threadsF), presolve,  // -1 threads: one per core
+        lockstep, useCache ? &cache : NULL);
+  }
 
   Sudoku s;
   switch (s.loadInstance(instanceFilename, true)) {
@@ -134,18 +450,88 @@ int main(int argc, char *argv[]) {
       printf("\nGiven instance is not possible to solve.\n");
       return 7;
   }
+  if (presolve) {
+    presolved = s.presolve();
+    if (presolved < 0) {
+      printf("\nGiven instance is not possible to solve.\n");
+      return 7;
+    }
+  }
+
+  // a checkpoint brings the settings it was taken with
+  SAParams saved;
+  if (resumeFilename != NULL) {
+    std::vector<uint8_t> data;
+    if (!readCheckpoint(resumeFilename, &data)) {
+      printf("\nCouldn't open checkpoint file \"%s\"\n\n", resumeFilename);
+      return 3;
+    }
+    switch (s.loadCheckpoint(data, &saved)) {
+      case 0:
+        printf("\nInvalid checkpoint file \"%s\"\n\n", resumeFilename);
+        return 6;
+      case -1:
+        printf("\nCheckpoint \"%s\" is for other givens (another instance,"
+            " or presolve on/off)\n\n", resumeFilename);
+        return 6;
+    }
+    if (timeLimitF != -1) saved.maxSeconds = params.maxSeconds;
+    if (proposalsLimitF != -1) saved.maxProposals = params.maxProposals;
+    params = saved;
+    // for the report below
+    restart = params.restart;
+    adaptive = params.adaptive;
+    moves = params.moves == kConflictMoves ? "conflict" : "random";
+    initialTemp = params.initialTemp > 0 ? params.initialTemp : -1;
+    tempDecrease = params.alpha;
+    tempStagesF = params.stagesLength > 0 ? params.stagesLength : -1;
+    randomSeedF = params.randomSeed;
+  }
 
   printf("\nParameters:\n");
 
   printf("  instance file:\t");
-  if (instanceFilename == '\0') {
+  if (instanceFilename == NULL) {
     printf("stdin\n");
   } else {
     printf("%s\n", instanceFilename);
   }
 
+  printf("  presolve:\t\t");
+  if (presolve) {
+    printf("%d cells fixed\n", presolved);
+  } else {
+    printf("disabled\n");
+  }
+
+  printf("  engine:\t\t%s\n", engine.c_str());
+  HybridParams hybrid;
+  if (engine == "hybrid") {
+    hybrid.handoffCost = handoffF == -1 ? s.order()
+      : static_cast<int>(handoffF);
+    hybrid.freeCells = exactFreeF == -1
+      ? s.order()*s.order()*s.order()*s.order() / 2
+      : static_cast<int>(exactFreeF);
+    printf("  hand off:\t\tat cost %d, or first if <= %d free cells\n",
+        hybrid.handoffCost, hybrid.freeCells);
+  }
+
+  printf("  schedule:\t\t%s\n", adaptive ? "adaptive" : "geometric");
+  printf("  moves:\t\t%s", moves.c_str());
+  if (params.moves == kConflictMoves) {
+    printf(" (bias %.2f)", params.conflictBias);
+  }
+  if (params.rejectionFree) {
+    printf(", rejection-free below %.4f acceptance",
+        params.rejectionFreeBelow);
+  }
+  printf("\n");
+
   printf("  initial temp.:\t");
-  if (initialTemp == -1) {
+  if (initialTemp == -1 && adaptive) {
+    printf("not set. Measured on the instance.\n");
+    initialTemp = 0;
+  } else if (initialTemp == -1) {
     printf("not set. Assuming default [instance order * 100].\n");
     initialTemp = s.order() * 100;
   } else {
@@ -153,7 +539,9 @@ int main(int argc, char *argv[]) {
   }
 
   printf("  alpha:\t\t");
-  if (tempDecrease == -1) {
+  if (adaptive) {
+    printf("adaptive\n");
+  } else if (tempDecrease == -1) {
     printf("not set. Assuming default [0.9].\n");
     tempDecrease = 0.9;
   } else {
@@ -161,7 +549,10 @@ int main(int argc, char *argv[]) {
   }
 
   printf("  stages length:\t");
-  if (tempStagesF == -1) {
+  if (tempStagesF == -1 && adaptive) {
+    printf("not set. Assuming [number of free cells].\n");
+    tempStages = 0;
+  } else if (tempStagesF == -1) {
     printf("not set. Assuming default [(instance order)^2].\n");
     tempStages = s.order()*s.order();
   } else {
@@ -178,6 +569,106 @@ int main(int argc, char *argv[]) {
     printf("%d\n", randomSeed);
   }
 
+  printf("  threads:\t\t");
+  if (threadsF == -1) {
+    if (replicasF == -1) {
+      printf("not set. Assuming default [1].\n");
+      threads = 1;
+    } else {
+      printf("not set. Assuming default [one per core].\n");
+      threads = 0;
+    }
+  } else if (threadsF < 1) {
+    printf("\nInvalid number of threads (%f)\n", threadsF);
+    return 5;
+  } else {
+    threads = static_cast<int>(threadsF);
+    printf("%d\n", threads);
+  }
+
+  if (replicasF != -1) {
+    if (replicasF < 1) {
+      printf("\nInvalid number of replicas (%f)\n", replicasF);
+      return 5;
+    }
+    replicas = static_cast<int>(replicasF);
+    printf("  PT replicas:\t\t%d\n", replicas);
+
+    printf("  PT exchange interval:\t");
+    if (exchangeF == -1) {
+      printf("not set. Assuming default [(instance order)^4].\n");
+      exchangeInterval = s.order()*s.order()*s.order()*s.order();
+    } else {
+      exchangeInterval = static_cast<int>(exchangeF);
+      printf("%d\n", exchangeInterval);
+    }
+
+    printf("  PT temperatures:\t");
+    if (minTempF == -1) minTempF = 0.2;
+    if (maxTempF == -1) maxTempF = 2.0;
+    if (minTempF <= 0 || maxTempF < minTempF || exchangeInterval < 1) {
+      printf("\nInvalid parallel tempering settings\n");
+      return 5;
+    }
+    printf("[%f, %f]\n", minTempF, maxTempF);
+  }
+
+  printf("  budget:\t\t");
+  if (params.maxSeconds > 0 || params.maxProposals > 0) {
+    if (params.maxSeconds > 0) printf("%fs ", params.maxSeconds);
+    if (params.maxProposals > 0) printf("%lld proposals", params.maxProposals);
+    printf("\n");
+  } else {
+    printf("not set. Assuming default [none].\n");
+  }
+  printf("  on stall:\t\t");
+  if (params.stallStages > 0) {
+    printf("%s after %d stages\n", restart ? "restart" : "reheat",
+        params.stallStages);
+  } else {
+    printf("nothing\n");
+  }
+  if (traceFilename != NULL) {
+    printf("  trace:\t\t\t");
+    if (!kTelemetryEnabled) {
+      printf("ignored (built without telemetry)\n");
+    } else if (replicasF != -1 || threads != 1) {
+      printf("ignored (only for a single annealer)\n");
+    } else if (!trace.open(traceFilename,
+          traceEveryF == -1 ? 100 : static_cast<int>(traceEveryF))) {
+      printf("\nCouldn't create trace file \"%s\"\n", traceFilename);
+      return 1;
+    } else {
+      printf("%s\n", traceFilename);
+      s.setTrace(&trace);
+    }
+  }
+
+  if (checkpointFilename != NULL) {
+    printf("  checkpoint:\t\t");
+    if (!checkpoint.open(checkpointFilename,
+          checkpointEveryF == -1 ? 60 : checkpointEveryF)) {
+      printf("\nCouldn't create checkpoint file \"%s\"\n",
+          checkpointFilename);
+      return 1;
+    }
+    printf("%s every %gs\n", checkpointFilename,
+        checkpointEveryF == -1 ? 60 : checkpointEveryF);
+    s.setCheckpoint(&checkpoint);
+    s.setStopFlag(&stopRequested);
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+  }
+  if (resumeFilename != NULL) {
+    printf("  resume:\t\tfrom \"%s\", with its settings\n", resumeFilename);
+  }
+
+  params.initialTemp = initialTemp;
+  params.alpha = tempDecrease;
+  params.stagesLength = tempStages;
+  params.randomSeed = randomSeed;
+  if (resumeFilename != NULL) params = saved;  // exactly as saved
+
   if (verbose) {
     printf("\n##############\n");
     printf("# Input info #\n");
@@ -188,8 +679,70 @@ int main(int argc, char *argv[]) {
   printf("\nSolving... ");
   int is, fs;
   double runtime;
-  s.solve(initialTemp, tempDecrease, tempStages, randomSeed,
-      &is, &fs, &runtime);
+  CanonicalForm form;
+  bool cached = false;
+  SAResult sa;
+  PortfolioResult race;
+  TemperingResult pt;
+  ExactResult exact;
+  HybridResult hy;
+  bool interrupted = false;
+  if (cacheFilename != NULL) {
+    std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+    TBoard solution;
+    canonicalize(s.order(), s.givens(), &form);
+    cached = cache.lookup(form, &solution) && s.setBoard(solution) == 0;
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+    runtime = elapsed.count();
+  }
+  if (cached) {
+    is = -1;
+    fs = 0;
+  } else if (engine == "exact") {
+    solveExact(&s, NULL, 0, params.maxSeconds, &exact);
+    if (exact.status == kExactNoSolution) {
+      printf("\nGiven instance is not possible to solve.\n");
+      return 7;
+    } else if (exact.status == kExactUnsupported) {
+      printf("\nThe exact engine only handles orders up to 8.\n");
+      return 5;
+    }
+    is = -1;
+    fs = exact.status == kExactSolved ? 0 : -1;
+    runtime = exact.seconds;
+  } else if (engine == "hybrid") {
+    solveHybrid(&s, params, hybrid, &hy);
+    if (hy.unsolvable) {
+      printf("\nGiven instance is not possible to solve.\n");
+      return 7;
+    }
+    is = hy.initialSolution;
+    fs = hy.finalSolution;
+    runtime = hy.seconds;
+  } else if (replicasF != -1) {
+    solveTempering(&s, replicas, minTempF, maxTempF, exchangeInterval, threads,
+        randomSeed, params.maxSeconds, params.maxProposals, &pt);
+    is = pt.initialSolution;
+    fs = pt.finalSolution;
+    runtime = pt.seconds;
+  } else if (threads == 1) {
+    s.solve(params, &sa);
+    interrupted = sa.status == kStopped;
+    is = sa.initialSolution;
+    fs = sa.finalSolution;
+    runtime = sa.seconds;
+  } else {
+    solvePortfolio(&s, threads, threads, params, &race);
+    is = race.initialSolution;
+    fs = race.finalSolution;
+    runtime = race.seconds;
+  }
+  bool verified = fs == 0 && s.verifySolution();
+  if (verified && !cached && cacheFilename != NULL) {
+    cache.store(form, s.board());
+  }
   if (fs == 0) {
     printf("OK!\n");
   } else {
@@ -197,9 +750,46 @@ int main(int argc, char *argv[]) {
   }
 
   printf("Execution info:\n");
-  printf("  Initial Solution:\t%d\n", is);
-  printf("  Final Solution:\t%d\n", fs);
-  printf("  Runtime:\t\t~%fs\n\n", runtime);
+  printf("  Status:\t\t%s\n", fs == 0 ? "optimal"
+      : (interrupted ? "interrupted" : "best found within budget"));
+  if (is >= 0) printf("  Initial Solution:\t%d\n", is);
+  if (fs >= 0) printf("  Final Solution:\t%d\n", fs);
+  if (fs == 0) {
+    printf("  Verified:\t\t%s\n", verified ? "yes" : "NO");
+  }
+  printf("  Runtime:\t\t~%fs\n", runtime);
+  if (cached) {
+    printf("  Cache:\t\thit (%s)\n", cacheFilename);
+  } else if (engine == "exact") {
+    printf("  Nodes:\t\t%lld\n", exact.nodes);
+  } else if (engine == "hybrid") {
+    printf("  Proposals:\t\t%lld\n", hy.proposals);
+    printf("  Exact attempts:\t%d (%lld nodes)%s\n", hy.handoffs, hy.nodes,
+        hy.solvedByExact ? ", solved by exact" : "");
+  } else if (replicasF != -1) {
+    printf("  Proposals:\t\t%lld\n", pt.proposals);
+    printf("  PT rounds:\t\t%ld\n", pt.rounds);
+    printf("  PT exchanges:\t\t%ld of %ld accepted\n", pt.accepted,
+        pt.exchanges);
+    printf("  Kept replica:\t\t%d (seed %u) at T=%f\n", pt.replica,
+        randomSeed + pt.replica, pt.temperature);
+  } else if (threads == 1) {
+    printf("  Proposals:\t\t%lld\n", sa.proposals);
+    printf("  Reheats:\t\t%d\n", sa.reheats);
+    if (kTelemetryEnabled && sa.proposals > 0) {
+      printf("  Accepted:\t\t%lld (%.2f%%), %lld uphill\n", sa.accepted,
+          100.0 * sa.accepted / sa.proposals, sa.uphillAccepted);
+    }
+  } else if (threads > 1) {
+    printf("  %s seed:\t\t%u (run %d of %d)\n", fs == 0 ? "Winning" : "Best",
+        race.seed, race.winner + 1, threads);
+  }
+  if (checkpoint.isOpen()) {
+    checkpoint.close();
+    printf("  Checkpoints:\t\t%ld written to \"%s\"%s\n", checkpoint.written(),
+        checkpointFilename, checkpoint.failed() ? " (some writes FAILED)" : "");
+  }
+  printf("\n");
 
   if (verbose) {
     printf("\n###############\n");
@@ -210,5 +800,6 @@ int main(int argc, char *argv[]) {
   s.dumpBoardToFile(outputFilename);
   printf("Solution dumped to file \"%s\".", outputFilename);
   printf("\n");
-  return 0;
+  if (fs == 0 && !verified) return 9;
+  return fs == 0 ? 0 : 8;
 }
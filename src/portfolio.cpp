@@ -0,0 +1,85 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <portfolio.h>
+#include <thread_pool.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+bool solvePortfolio(Sudoku* instance, int runs, int threads,
+    const SAParams& params, PortfolioResult* result) {
+  std::vector<Sudoku> solvers(runs, *instance);
+  std::vector<SAResult> outcome(runs);
+  std::vector<bool> started(runs, false);
+  std::atomic<bool> stop(false);
+  std::mutex winnerMutex;
+  int winner = -1;
+
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool(threads);
+    for (int k = 0; k < runs; ++k) {
+      solvers[k].setStopFlag(&stop);
+      pool.submit([&, k]() {
+        if (stop.load()) return;  // someone already won before this one started
+        SAParams mine = params;
+        mine.randomSeed = params.randomSeed + k;
+        bool solved = solvers[k].solve(mine, &outcome[k]);
+        std::lock_guard<std::mutex> lock(winnerMutex);
+        started[k] = true;
+        if (solved) {
+          if (winner < 0) winner = k;
+          stop.store(true);
+        }
+      });
+    }
+    pool.wait();
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - begin;
+
+  result->proposals = 0;
+  for (int k = 0; k < runs; ++k) {
+    if (!started[k]) continue;
+    result->proposals += outcome[k].proposals;
+    // nobody solved it: keep the best run
+    if (winner < 0 || (outcome[winner].status != kSolved
+          && outcome[k].finalSolution < outcome[winner].finalSolution)) {
+      winner = k;
+    }
+  }
+  *instance = solvers[winner];
+  instance->setStopFlag(NULL);
+  result->winner = winner;
+  result->seed = params.randomSeed + winner;
+  result->status = outcome[winner].status;
+  result->initialSolution = outcome[winner].initialSolution;
+  result->finalSolution = outcome[winner].finalSolution;
+  result->seconds = elapsed.count();
+  return result->status == kSolved;
+}
@@ -0,0 +1,224 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+// Solve server (see include/server.h for the protocol). By default requests
+// come on stdin and replies go to stdout (anything else the solver prints
+// goes to stderr); with -socket, it listens on a Unix domain socket and
+// serves every connection at once, e.g.
+//   bin/serve -socket /tmp/sudoku.sock -deadline 10 &
+//   (echo "solve a"; cat etc/4_45; echo stats) | nc -U /tmp/sudoku.sock
+
+#include <server.h>
+#include <solution_cache.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace {
+
+void usage() {
+  printf("\nUsage: serve [options]\n");
+  printf("Solves the puzzles of 'solve' requests on a pool of workers (protocol in\n");  // NOLINT
+  printf("include/server.h).\n\n");
+  printf("Options:\n");
+  printf("  -socket <P>   \t: Listen on the Unix domain socket P. Default: stdin/stdout\n");  // NOLINT
+  printf("  -workers <N>  \t: Solving threads. Default: one per core\n");
+  printf("  -deadline <N> \t: Seconds per request (queue wait included) unless given. Default: none\n");  // NOLINT
+  printf("  -queue <N>    \t: Refuse requests when N are waiting. Default: 1024\n");  // NOLINT
+  printf("  -cache <N>    \t: Reuse the solutions of up to N puzzles, by canonical form\n");  // NOLINT
+  printf("  -it/-alpha/-sl/-tl/-il/-stall <N>: Annealing settings, as in sudoku\n");  // NOLINT
+  printf("  -restart, -adaptive, -nopresolve: As in sudoku\n");
+  printf("\n");
+}
+
+// Writes all of 'line' to a socket. Gives up if the peer went away.
+void sendAll(int fd, const std::string& line) {
+  size_t sent = 0;
+  while (sent < line.size()) {
+    ssize_t k = send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0) return;
+    sent += k;
+  }
+}
+
+int serveSocket(SolveServer* server, const char* path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "\nSocket path too long \"%s\"\n", path);
+    return 5;
+  }
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path);
+  if (listenFd < 0
+      || bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr),
+        sizeof(addr)) != 0
+      || listen(listenFd, 16) != 0) {
+    fprintf(stderr, "\nCouldn't listen on \"%s\": %s\n", path,
+        strerror(errno));
+    if (listenFd >= 0) close(listenFd);
+    return 1;
+  }
+  fprintf(stderr, "Listening on %s\n", path);
+
+  std::mutex mutex;
+  std::condition_variable closed;
+  std::set<int> connections;   // open connections, to unblock on shutdown
+  for (;;) {
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0 && errno == EINTR) continue;
+    if (fd < 0 || server->stopping()) {
+      if (fd >= 0) close(fd);
+      break;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    connections.insert(fd);
+    std::thread([&, fd]() {
+      FILE* in = fdopen(dup(fd), "r");
+      std::mutex writing;
+      bool keepRunning = in == NULL || server->serve(in,
+          [&](const std::string& line) {
+            std::unique_lock<std::mutex> lock(writing);
+            sendAll(fd, line);
+          });
+      if (in != NULL) fclose(in);
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!keepRunning) {  // shutdown: stop accepting, end the connections
+        ::shutdown(listenFd, SHUT_RDWR);
+        for (std::set<int>::iterator it = connections.begin();
+            it != connections.end(); ++it) {
+          ::shutdown(*it, SHUT_RD);
+        }
+      }
+      connections.erase(fd);
+      close(fd);
+      closed.notify_all();
+    }).detach();
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (std::set<int>::iterator it = connections.begin();
+        it != connections.end(); ++it) {
+      ::shutdown(*it, SHUT_RD);
+    }
+    while (!connections.empty()) closed.wait(lock);
+  }
+  close(listenFd);
+  unlink(path);
+  return 0;
+}
+
+}  // namespace
+
+// Exit values: 0 ok, 1 couldn't listen, 4 invalid argument, 5 invalid value.
+int main(int argc, char* argv[]) {
+  ServerOptions options;
+  const char* socketPath = NULL;
+  long cacheSize = 0;
+
+  options.workers = 0;
+  options.presolve = true;
+  options.deadline = 0;
+  options.maxQueue = 1024;
+  options.cache = NULL;
+  options.params.stallStages = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string str = argv[i];
+    bool hasValue = i+1 < argc;
+    if (str == "-h" || str == "-help") {
+      usage();
+      return 0;
+    } else if (str == "-nopresolve") {
+      options.presolve = false;
+    } else if (str == "-restart") {
+      options.params.restart = true;
+    } else if (str == "-adaptive") {
+      options.params.adaptive = true;
+    } else if (!hasValue) {
+      fprintf(stderr, "\nMissing value for \"%s\"\n", argv[i]);
+      return 5;
+    } else if (str == "-socket") {
+      socketPath = argv[++i];
+    } else if (str == "-workers") {
+      options.workers = atoi(argv[++i]);
+    } else if (str == "-deadline") {
+      options.deadline = atof(argv[++i]);
+    } else if (str == "-queue") {
+      options.maxQueue = atol(argv[++i]);
+    } else if (str == "-cache") {
+      cacheSize = atol(argv[++i]);
+    } else if (str == "-it") {
+      options.params.initialTemp = atof(argv[++i]);
+    } else if (str == "-alpha") {
+      options.params.alpha = atof(argv[++i]);
+    } else if (str == "-sl") {
+      options.params.stagesLength = atoi(argv[++i]);
+    } else if (str == "-tl") {
+      options.params.maxSeconds = atof(argv[++i]);
+    } else if (str == "-il") {
+      options.params.maxProposals = atoll(argv[++i]);
+    } else if (str == "-stall") {
+      options.params.stallStages = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "\nUnknown argument #%d \"%s\"\n", i, argv[i]);
+      usage();
+      return 4;
+    }
+  }
+  if (options.deadline < 0 || options.maxQueue < 1 || cacheSize < 0) {
+    fprintf(stderr, "\nInvalid settings.\n");
+    return 5;
+  }
+
+  SolutionCache cache(cacheSize);
+  if (cacheSize > 0) options.cache = &cache;
+  SolveServer server(options);
+  if (socketPath != NULL) return serveSocket(&server, socketPath);
+
+  // replies on the original stdout; the solver's own messages to stderr
+  FILE* out = fdopen(dup(STDOUT_FILENO), "w");
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+  std::mutex writing;
+  server.serve(stdin, [&](const std::string& line) {
+    std::unique_lock<std::mutex> lock(writing);
+    fputs(line.c_str(), out);
+    fflush(out);
+  });
+  fclose(out);
+  return 0;
+}
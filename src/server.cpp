@@ -0,0 +1,404 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <server.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Next line of 'in', without the newline. False at the end of the stream.
+bool readLine(FILE* in, std::string* line) {
+  int c;
+  line->clear();
+  while ((c = getc(in)) != EOF && c != '\n') line->push_back(c);
+  return c != EOF || !line->empty();
+}
+
+// Next whitespace separated token of 'in'. False at the end of the stream.
+bool readToken(FILE* in, std::string* token) {
+  int c;
+  token->clear();
+  while ((c = getc(in)) != EOF && isspace(c)) {}
+  while (c != EOF && !isspace(c)) {
+    token->push_back(c);
+    c = getc(in);
+  }
+  if (c == '\n') ungetc(c, in);  // so that the request line ends there
+  return !token->empty();
+}
+
+std::vector<std::string> split(const std::string& line) {
+  std::vector<std::string> tokens;
+  size_t k = 0;
+  while (k < line.size()) {
+    while (k < line.size() && isspace(line[k])) ++k;
+    size_t begin = k;
+    while (k < line.size() && !isspace(line[k])) ++k;
+    if (k > begin) tokens.push_back(line.substr(begin, k - begin));
+  }
+  return tokens;
+}
+
+// Integer value of a token; false if it isn't one.
+bool toInt(const std::string& token, long* value) {
+  char* end;
+  *value = strtol(token.c_str(), &end, 10);
+  return !token.empty() && *end == '\0';
+}
+
+double milliseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}  // namespace
+
+SolveServer::SolveServer(const ServerOptions& options)
+  : _options(options), _stopping(false), _sequence(0), _latencyNext(0) {
+  int workers = options.workers > 0 ? options.workers
+    : std::max<int>(1, std::thread::hardware_concurrency());
+  memset(&_stats, 0, sizeof(_stats));
+  for (int k = 0; k < workers; ++k) {
+    _workers.push_back(std::thread(&SolveServer::workerLoop, this));
+  }
+}
+
+SolveServer::~SolveServer() {
+  shutdown();
+  for (size_t k = 0; k < _workers.size(); ++k) _workers[k].join();
+}
+
+bool SolveServer::serve(FILE* in, const Reply& reply) {
+  std::shared_ptr<Session> session = std::make_shared<Session>();
+  std::string line;
+  bool keepRunning = true;
+  session->reply = reply;
+  session->pending = 0;
+  while (!_stopping.load() && readLine(in, &line)) {
+    std::vector<std::string> tokens = split(line);
+    if (tokens.empty()) continue;
+    if (tokens[0] == "solve") {
+      handleSolve(line, in, session);
+    } else if (tokens[0] == "cancel" && tokens.size() == 2) {
+      handleCancel(tokens[1], session.get());
+    } else if (tokens[0] == "stats") {
+      ServerStats s = stats();
+      char buffer[256];
+      snprintf(buffer, sizeof(buffer), "stats queued=%ld running=%ld "
+          "received=%ld solved=%ld best=%ld cancelled=%ld expired=%ld "
+          "invalid=%ld p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f\n", s.queued,
+          s.running, s.received, s.solved, s.best, s.cancelled, s.expired,
+          s.invalid, s.p50, s.p90, s.p99);
+      reply(buffer);
+    } else if (tokens[0] == "quit") {
+      break;
+    } else if (tokens[0] == "shutdown") {
+      keepRunning = false;
+      shutdown();
+      break;
+    } else {
+      reply("error - unknown request \"" + tokens[0] + "\"\n");
+    }
+  }
+  std::unique_lock<std::mutex> lock(session->mutex);
+  while (session->pending > 0) session->done.wait(lock);
+  return keepRunning && !_stopping.load();
+}
+
+// Reads the rest of a solve request: options, then the instance, from the
+// rest of the line and, if it doesn't fit there, from the stream. The whole
+// instance is read even if something is wrong, to stay in sync.
+void SolveServer::handleSolve(const std::string& line, FILE* in,
+    const std::shared_ptr<Session>& session) {
+  std::vector<std::string> tokens = split(line);
+  size_t k = 2;
+  std::string token, problem;
+  long order, value;
+  double deadline = _options.deadline;
+  long seed = -1;
+
+  if (tokens.size() < 2) {
+    session->reply("error - missing request id\n");
+    return;
+  }
+  const std::string& id = tokens[1];
+  for (; k < tokens.size() && tokens[k].find('=') != std::string::npos; ++k) {
+    std::string key = tokens[k].substr(0, tokens[k].find('='));
+    std::string arg = tokens[k].substr(tokens[k].find('=') + 1);
+    char* end;
+    if (key == "deadline") {
+      deadline = strtod(arg.c_str(), &end);
+      if (*end != '\0' || deadline < 0) problem = "invalid deadline";
+    } else if (key == "seed") {
+      if (!toInt(arg, &seed) || seed < 0) problem = "invalid seed";
+    } else {
+      problem = "unknown option \"" + key + "\"";
+    }
+  }
+  // the instance: order, then order^4 values
+  if (k < tokens.size()) {
+    token = tokens[k++];
+  } else if (!readToken(in, &token)) {
+    token.clear();
+  }
+  if (!toInt(token, &order) || order < 1 || order >= 50) {
+    session->reply("error " + id + " invalid board size\n");
+    return;
+  }
+  const long cells = order*order*order*order;
+  std::vector<int> values(cells);
+  for (long c = 0; c < cells; ++c) {
+    if (k < tokens.size()) {
+      token = tokens[k++];
+    } else if (!readToken(in, &token)) {
+      session->reply("error " + id + " incomplete instance\n");
+      return;
+    }
+    // anything else than -1 or 1..n fails the loading below
+    values[c] = toInt(token, &value) && value >= -1 && value <= cells
+      ? static_cast<int>(value) : cells + 1;
+    if (values[c] == 0) values[c] = cells + 1;
+  }
+  if (!problem.empty()) {
+    session->reply("error " + id + " " + problem + "\n");
+    return;
+  }
+
+  Request* request = new Request();
+  request->id = id;
+  request->arrival = request->started = Clock::now();
+  request->hasDeadline = deadline > 0;
+  request->deadline = request->arrival
+    + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(deadline));
+  request->running = false;
+  request->stop = false;
+  request->session = session;
+  {
+    std::unique_lock<std::mutex> lock(session->mutex);
+    ++session->pending;
+  }
+  if (request->sudoku.loadInstance(order, &values[0], true) != 1) {
+    finish(request, "invalid", 0);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_active.find(id) != _active.end() || _queue.size() >= _options.maxQueue) {
+    bool duplicate = _active.find(id) != _active.end();
+    lock.unlock();
+    session->reply("error " + id + (duplicate ? " duplicate id\n"
+          : " queue full\n"));
+    request->session.reset();
+    delete request;
+    std::unique_lock<std::mutex> sessionLock(session->mutex);
+    --session->pending;
+    return;
+  }
+  request->seed = seed >= 0 ? seed : _options.params.randomSeed + _sequence;
+  ++_sequence;
+  ++_stats.received;
+  _active[id] = request;
+  _queue.push_back(request);
+  // replied with the lock held, so that it comes before the result
+  char depth[32];
+  snprintf(depth, sizeof(depth), " %zu\n", _queue.size());
+  session->reply("queued " + id + depth);
+  _hasWork.notify_one();
+}
+
+void SolveServer::handleCancel(const std::string& id, Session* session) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  std::map<std::string, Request*>::iterator it = _active.find(id);
+  if (it == _active.end()) {
+    session->reply("error " + id + " unknown id\n");
+    return;
+  }
+  Request* request = it->second;
+  session->reply("cancelling " + id + "\n");
+  if (request->running) {
+    request->stop = true;  // the worker answers
+    return;
+  }
+  _queue.erase(std::find(_queue.begin(), _queue.end(), request));
+  lock.unlock();
+  finish(request, "cancelled", 0);
+}
+
+void SolveServer::shutdown() {
+  std::deque<Request*> queued;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopping = true;
+    queued.swap(_queue);
+    for (std::map<std::string, Request*>::iterator it = _active.begin();
+        it != _active.end(); ++it) {
+      it->second->stop = true;
+    }
+    _hasWork.notify_all();
+  }
+  for (size_t k = 0; k < queued.size(); ++k) {
+    finish(queued[k], "cancelled", 0);
+  }
+}
+
+ServerStats SolveServer::stats() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  ServerStats s = _stats;
+  s.queued = _queue.size();
+  std::vector<double> sorted(_latencies);
+  lock.unlock();
+  std::sort(sorted.begin(), sorted.end());
+  double* p[3] = { &s.p50, &s.p90, &s.p99 };
+  const double percent[3] = { 50, 90, 99 };
+  for (int k = 0; k < 3; ++k) {
+    size_t rank = static_cast<size_t>(ceil(percent[k] / 100 * sorted.size()));
+    *p[k] = sorted.empty() ? 0 : sorted[std::max<size_t>(rank, 1) - 1];
+  }
+  return s;
+}
+
+void SolveServer::workerLoop() {
+  for (;;) {
+    Request* request;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (_queue.empty() && !_stopping.load()) _hasWork.wait(lock);
+      if (_queue.empty()) return;
+      request = _queue.front();
+      _queue.pop_front();
+      request->running = true;
+      request->started = Clock::now();
+      ++_stats.running;
+    }
+    if (request->hasDeadline && request->started >= request->deadline) {
+      finish(request, "expired", 0);
+    } else {
+      solve(request);
+    }
+  }
+}
+
+void SolveServer::solve(Request* request) {
+  Sudoku& s = request->sudoku;
+  SAParams params = _options.params;
+  SAResult result = SAResult();
+  CanonicalForm form;
+  TBoard cachedSolution;
+  bool hit = false, solved;
+  int order = s.order();
+
+  result.status = kNoMoves;  // a cache hit doesn't solve
+
+  if (!params.adaptive) {
+    if (params.initialTemp <= 0) params.initialTemp = order * 100;
+    if (params.stagesLength <= 0) params.stagesLength = order * order;
+  }
+  params.randomSeed = request->seed;
+  if (request->hasDeadline) {
+    double remaining = std::chrono::duration<double>(
+        request->deadline - request->started).count();
+    if (params.maxSeconds <= 0 || remaining < params.maxSeconds) {
+      params.maxSeconds = remaining;
+    }
+  }
+  s.setStopFlag(&request->stop);
+  if (_options.presolve && s.presolve() < 0) {
+    finish(request, "invalid", milliseconds(Clock::now() - request->started));
+    return;
+  }
+  if (_options.cache != NULL) {
+    canonicalize(order, s.givens(), &form);
+    hit = _options.cache->lookup(form, &cachedSolution)
+      && s.setBoard(cachedSolution) == 0;
+  }
+  solved = hit || s.solve(params, &result);
+  bool ok = solved && s.verifySolution();
+  if (ok && !hit && _options.cache != NULL) {
+    _options.cache->store(form, s.board());
+  }
+  finish(request, ok ? "solved" : (result.status == kStopped ? "cancelled"
+        : "best"), milliseconds(Clock::now() - request->started));
+}
+
+void SolveServer::finish(Request* request, const char* status,
+    double solveMs) {
+  Clock::time_point now = Clock::now();
+  bool withBoard = !strcmp(status, "solved") || !strcmp(status, "best");
+  double waitMs = milliseconds((request->running ? request->started : now)
+      - request->arrival);
+  char buffer[128];
+  std::string line = "result " + request->id + " " + status;
+  snprintf(buffer, sizeof(buffer), " %d %.3f %.3f",
+      withBoard ? request->sudoku.evaluateCurrentSolution() : -1, waitMs,
+      solveMs);
+  line += buffer;
+  if (withBoard) {
+    int n = request->sudoku.order() * request->sudoku.order();
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        int v = request->sudoku.cell(i, j);
+        snprintf(buffer, sizeof(buffer), " %d", v > 0 ? v : -1);
+        line += buffer;
+      }
+    }
+  }
+  line += '\n';
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::map<std::string, Request*>::iterator it = _active.find(request->id);
+    if (it != _active.end() && it->second == request) _active.erase(it);
+    if (request->running) --_stats.running;
+    if (!strcmp(status, "solved")) {
+      ++_stats.solved;
+    } else if (!strcmp(status, "best")) {
+      ++_stats.best;
+    } else if (!strcmp(status, "cancelled")) {
+      ++_stats.cancelled;
+    } else if (!strcmp(status, "expired")) {
+      ++_stats.expired;
+    } else {
+      ++_stats.invalid;
+    }
+    double latency = milliseconds(now - request->arrival);
+    if (_latencies.size() < static_cast<size_t>(kLatencyWindow)) {
+      _latencies.push_back(latency);
+    } else {
+      _latencies[_latencyNext] = latency;
+      _latencyNext = (_latencyNext + 1) % kLatencyWindow;
+    }
+  }
+  std::shared_ptr<Session> session = request->session;
+  session->reply(line);
+  delete request;
+  std::unique_lock<std::mutex> lock(session->mutex);
+  --session->pending;
+  session->done.notify_all();
+}
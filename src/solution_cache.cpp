@@ -0,0 +1,438 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <solution_cache.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kCacheMagic[8] = { 'S', 'U', 'D', 'O', 'K', 'U', 'S', '1' };
+
+// Candidate transforms tried per orientation; above that, ties are broken
+// by position.
+const long kMaxCandidates = 1024;
+
+// Dense ranks of the signatures: equal signatures get equal ranks, ordered
+// like the signatures (so ranks don't depend on the order of the input).
+void rankSignatures(const std::vector<std::vector<int> >& sigs,
+    std::vector<int>* ranks) {
+  std::vector<int> idx(sigs.size());
+  for (size_t k = 0; k < idx.size(); ++k) idx[k] = k;
+  std::sort(idx.begin(), idx.end(),
+      [&](int a, int b) { return sigs[a] < sigs[b]; });
+  ranks->assign(sigs.size(), 0);
+  for (size_t k = 1; k < idx.size(); ++k) {
+    (*ranks)[idx[k]] = (*ranks)[idx[k-1]]
+      + (sigs[idx[k]] != sigs[idx[k-1]] ? 1 : 0);
+  }
+}
+
+// Colors of the rows and columns of a grid that don't change under the
+// symmetries: starting from the number of givens of each row, column and
+// value, each round colors a row by the colors of the columns and values of
+// its givens (and likewise for columns and values).
+void refineColors(int n, const TBoard& grid, std::vector<int>* rowColor,
+    std::vector<int>* colColor) {
+  std::vector<std::vector<int> > rowSig(n), colSig(n), valueSig(n+1);
+  std::vector<int> valueColor;
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      int v = grid[i*n + j];
+      if (v == 0) continue;
+      rowSig[i].push_back(0);
+      colSig[j].push_back(0);
+      valueSig[v].push_back(0);
+    }
+  }
+  rankSignatures(rowSig, rowColor);
+  rankSignatures(colSig, colColor);
+  rankSignatures(valueSig, &valueColor);
+  for (int round = 0; round < 3; ++round) {
+    for (int k = 0; k < n; ++k) {
+      rowSig[k].assign(1, (*rowColor)[k]);
+      colSig[k].assign(1, (*colColor)[k]);
+    }
+    for (int v = 0; v <= n; ++v) valueSig[v].assign(1, valueColor[v]);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        int v = grid[i*n + j];
+        if (v == 0) continue;
+        rowSig[i].push_back((*colColor)[j]*(n+1) + valueColor[v]);
+        colSig[j].push_back((*rowColor)[i]*(n+1) + valueColor[v]);
+        valueSig[v].push_back((*rowColor)[i]*n + (*colColor)[j]);
+      }
+    }
+    for (int k = 0; k < n; ++k) {
+      std::sort(rowSig[k].begin() + 1, rowSig[k].end());
+      std::sort(colSig[k].begin() + 1, colSig[k].end());
+    }
+    for (int v = 0; v <= n; ++v) {
+      std::sort(valueSig[v].begin() + 1, valueSig[v].end());
+    }
+    rankSignatures(rowSig, rowColor);
+    rankSignatures(colSig, colColor);
+    rankSignatures(valueSig, &valueColor);
+  }
+}
+
+// Candidate orders of the rows (or columns) of a grid: bands sorted by the
+// sorted colors of their rows and rows by color within each band. Runs of
+// equal keys are tie groups, whose permutations are enumerated by next().
+class LineOrder {
+  public:
+    LineOrder(int order, const std::vector<int>& color) : _order(order) {
+      std::vector<std::vector<int> > bandKey(order);
+      _rows.resize(order);
+      for (int b = 0; b < order; ++b) {
+        for (int k = 0; k < order; ++k) _rows[b].push_back(b*order + k);
+        std::stable_sort(_rows[b].begin(), _rows[b].end(),
+            [&](int x, int y) { return color[x] < color[y]; });
+        for (int k = 0; k < order; ++k) {
+          bandKey[b].push_back(color[_rows[b][k]]);
+        }
+        _bands.push_back(b);
+      }
+      std::stable_sort(_bands.begin(), _bands.end(),
+          [&](int x, int y) { return bandKey[x] < bandKey[y]; });
+      addTies(-1, [&](int k) { return bandKey[_bands[k]]; });
+      for (int b = 0; b < order; ++b) {
+        addTies(b, [&](int k) {
+          return std::vector<int>(1, color[_rows[b][k]]);
+        });
+      }
+    }
+
+    // Number of candidates, or kMaxCandidates + 1 if more.
+    long candidates() const {
+      long count = 1;
+      for (size_t g = 0; g < _groups.size(); ++g) {
+        for (int k = 2; k <= _groups[g].end - _groups[g].begin; ++k) {
+          count *= k;
+          if (count > kMaxCandidates) return kMaxCandidates + 1;
+        }
+      }
+      return count;
+    }
+
+    // Keeps only the current candidate.
+    void dropTies() { _groups.clear(); }
+
+    // Advances to the next candidate. Returns false (and goes back to the
+    // first one) after the last.
+    bool next() {
+      for (size_t g = 0; g < _groups.size(); ++g) {
+        std::vector<int>& seq = _groups[g].band < 0 ? _bands
+          : _rows[_groups[g].band];
+        if (std::next_permutation(seq.begin() + _groups[g].begin,
+              seq.begin() + _groups[g].end)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Line k of the current candidate order.
+    void lines(std::vector<int>* out) const {
+      out->clear();
+      for (int b = 0; b < _order; ++b) {
+        const std::vector<int>& rows = _rows[_bands[b]];
+        out->insert(out->end(), rows.begin(), rows.end());
+      }
+    }
+
+  private:
+    struct TieGroup {
+      int band;         // -1: the band order, else the rows of that band
+      int begin, end;
+    };
+
+    template <typename Key>
+    void addTies(int band, Key key) {
+      int begin = 0;
+      for (int k = 1; k <= _order; ++k) {
+        if (k == _order || key(k) != key(begin)) {
+          if (k - begin > 1) {
+            TieGroup g = { band, begin, k };
+            _groups.push_back(g);
+          }
+          begin = k;
+        }
+      }
+    }
+
+    int                             _order;
+    std::vector<int>                _bands;   // band b of the candidate
+    std::vector<std::vector<int> >  _rows;    // rows of each original band
+    std::vector<TieGroup>           _groups;
+};
+
+// Relabels 'grid' under the row and column orders (values by first
+// appearance) into 'candidate' and keeps it in 'best' if smaller. Gives up
+// as soon as it's known to be larger. Returns true if it was kept.
+bool tryCandidate(int n, const TBoard& grid, const std::vector<int>& rows,
+    const std::vector<int>& cols, bool haveBest, TBoard* candidate,
+    std::vector<TCell>* labels, TBoard* best) {
+  bool smaller = !haveBest;
+  TCell nextLabel = 1;
+  labels->assign(n+1, 0);
+  for (int r = 0, k = 0; r < n; ++r) {
+    const TCell* row = &grid[rows[r]*n];
+    for (int c = 0; c < n; ++c, ++k) {
+      TCell v = row[cols[c]], x = 0;
+      if (v != 0) {
+        if ((*labels)[v] == 0) (*labels)[v] = nextLabel++;
+        x = (*labels)[v];
+      }
+      if (!smaller) {
+        if (x > (*best)[k]) return false;
+        if (x < (*best)[k]) smaller = true;
+      }
+      (*candidate)[k] = x;
+    }
+  }
+  if (!smaller) return false;  // equal: keep the first
+  best->swap(*candidate);
+  return true;
+}
+
+std::string cacheKey(const CanonicalForm& form) {
+  uint16_t order = form.order;
+  std::string key(reinterpret_cast<const char*>(&order), sizeof(order));
+  key.append(reinterpret_cast<const char*>(&form.givens[0]),
+      form.givens.size() * sizeof(TCell));
+  return key;
+}
+
+}  // namespace
+
+// *****************
+// * CanonicalForm *
+// *****************
+
+void canonicalize(int order, const TBoard& givens, CanonicalForm* form) {
+  const int n = order * order;
+  TBoard grid, candidate(n*n), best(n*n);
+  std::vector<int> rowColor, colColor, rows, cols;
+  std::vector<TCell> labels;
+  bool haveBest = false;
+
+  form->order = order;
+  for (int t = 0; t < 2; ++t) {
+    grid = givens;
+    if (t == 1) {
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) grid[i*n + j] = givens[j*n + i];
+      }
+    }
+    refineColors(n, grid, &rowColor, &colColor);
+    LineOrder rowOrder(order, rowColor), colOrder(order, colColor);
+    // too many candidates: fix the side with more ties first
+    LineOrder* larger = rowOrder.candidates() >= colOrder.candidates()
+      ? &rowOrder : &colOrder;
+    LineOrder* smaller = larger == &rowOrder ? &colOrder : &rowOrder;
+    if (larger->candidates() * smaller->candidates() > kMaxCandidates) {
+      larger->dropTies();
+    }
+    if (smaller->candidates() > kMaxCandidates) smaller->dropTies();
+
+    do {
+      rowOrder.lines(&rows);
+      do {
+        colOrder.lines(&cols);
+        if (tryCandidate(n, grid, rows, cols, haveBest, &candidate, &labels,
+              &best)) {
+          haveBest = true;
+          form->transposed = t == 1;
+          form->rows = rows;
+          form->cols = cols;
+          form->labels = labels;
+        }
+      } while (colOrder.next());
+    } while (rowOrder.next());
+  }
+  form->givens.swap(best);
+
+  // values missing from the givens take the remaining labels in order
+  TCell nextLabel = 1;
+  for (int v = 1; v <= n; ++v) {
+    nextLabel = std::max<TCell>(nextLabel, form->labels[v] + 1);
+  }
+  for (int v = 1; v <= n; ++v) {
+    if (form->labels[v] == 0) form->labels[v] = nextLabel++;
+  }
+}
+
+void CanonicalForm::toCanonical(const TBoard& original,
+    TBoard* canonical) const {
+  const int n = order * order;
+  canonical->resize(n*n);
+  for (int r = 0; r < n; ++r) {
+    for (int c = 0; c < n; ++c) {
+      int i = rows[r], j = cols[c];
+      TCell v = transposed ? original[j*n + i] : original[i*n + j];
+      (*canonical)[r*n + c] = labels[v];
+    }
+  }
+}
+
+void CanonicalForm::toOriginal(const TBoard& canonical,
+    TBoard* original) const {
+  const int n = order * order;
+  std::vector<TCell> values(n+1, 0);
+  for (int v = 1; v <= n; ++v) values[labels[v]] = v;
+  original->resize(n*n);
+  for (int r = 0; r < n; ++r) {
+    for (int c = 0; c < n; ++c) {
+      int i = rows[r], j = cols[c];
+      TCell v = values[canonical[r*n + c]];
+      if (transposed) {
+        (*original)[j*n + i] = v;
+      } else {
+        (*original)[i*n + j] = v;
+      }
+    }
+  }
+}
+
+// *****************
+// * SolutionCache *
+// *****************
+
+SolutionCache::SolutionCache(size_t capacity)
+  : _capacity(std::max<size_t>(capacity, 1)), _file(NULL), _hits(0),
+    _misses(0) {}
+
+SolutionCache::~SolutionCache() {
+  if (_file != NULL) fclose(_file);
+}
+
+// File: the 8 bytes magic "SUDOKUS1", then one record per entry, in the
+// order they were stored: uint16 order, uint16 reserved, the n^2 canonical
+// givens and the n^2 values of the canonical solution (uint16 each).
+bool SolutionCache::open(const char* filename) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  char magic[8];
+  bool empty = true;
+  FILE* in = fopen(filename, "rb");
+  if (in != NULL) {
+    size_t got = fread(magic, 1, sizeof(magic), in);
+    bool ok = got == 0 || (got == sizeof(magic)
+        && memcmp(magic, kCacheMagic, sizeof(magic)) == 0);
+    empty = got == 0;
+    uint16_t fields[2];
+    while (ok && fread(fields, sizeof(fields), 1, in) == 1) {
+      const int n = fields[0] * fields[0];
+      CanonicalForm form;
+      TBoard solution(n*n);
+      form.order = fields[0];
+      form.givens.resize(n*n);
+      if (n == 0 || fread(&form.givens[0], sizeof(TCell), n*n, in)
+          != static_cast<size_t>(n*n)
+          || fread(&solution[0], sizeof(TCell), n*n, in)
+          != static_cast<size_t>(n*n)) {
+        break;  // truncated by a crash: keep what was complete
+      }
+      insert(cacheKey(form), solution);
+    }
+    fclose(in);
+    if (!ok) return false;
+  }
+  if (_file != NULL) fclose(_file);
+  _file = fopen(filename, "ab");
+  if (_file == NULL) return false;
+  if (empty && fwrite(kCacheMagic, sizeof(kCacheMagic), 1, _file) != 1) {
+    fclose(_file);
+    _file = NULL;
+    return false;
+  }
+  fflush(_file);
+  return true;
+}
+
+bool SolutionCache::lookup(const CanonicalForm& form, TBoard* solution) {
+  std::string key = cacheKey(form);
+  TBoard canonical;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::unordered_map<std::string, Entries::iterator>::iterator it =
+      _index.find(key);
+    if (it == _index.end()) {
+      ++_misses;
+      return false;
+    }
+    _entries.splice(_entries.begin(), _entries, it->second);
+    canonical = it->second->second;
+    ++_hits;
+  }
+  form.toOriginal(canonical, solution);
+  return true;
+}
+
+void SolutionCache::store(const CanonicalForm& form, const TBoard& solution) {
+  std::string key = cacheKey(form);
+  TBoard canonical;
+  form.toCanonical(solution, &canonical);
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (!insert(key, canonical) || _file == NULL) return;
+  uint16_t fields[2] = { static_cast<uint16_t>(form.order), 0 };
+  fwrite(fields, sizeof(fields), 1, _file);
+  fwrite(&form.givens[0], sizeof(TCell), form.givens.size(), _file);
+  fwrite(&canonical[0], sizeof(TCell), canonical.size(), _file);
+  fflush(_file);
+}
+
+bool SolutionCache::insert(const std::string& key, const TBoard& solution) {
+  std::unordered_map<std::string, Entries::iterator>::iterator it =
+    _index.find(key);
+  if (it != _index.end()) {
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return false;
+  }
+  _entries.push_front(std::make_pair(key, solution));
+  _index[key] = _entries.begin();
+  if (_entries.size() > _capacity) {
+    _index.erase(_entries.back().first);
+    _entries.pop_back();
+  }
+  return true;
+}
+
+size_t SolutionCache::size() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _entries.size();
+}
+
+long SolutionCache::hits() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _hits;
+}
+
+long SolutionCache::misses() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _misses;
+}
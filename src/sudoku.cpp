@@ -25,10 +25,15 @@
  */
 
 #include <sudoku.h>
-#include <stdlib.h>
+#include <bitboard.h>
+#include <instance_io.h>
 #include <math.h>
+#include <time.h>
+#include <chrono>
 #include <ctime>
+#include <cstring>
 #include <cassert>
+#include <climits>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -39,6 +44,18 @@ Sudoku::Sudoku() {
   _n = -1;
   _board.clear();
   _fixeds.clear();
+  _rowCount.clear();
+  _colCount.clear();
+  _freeCells.clear();
+  _squareStart.clear();
+  _movableSquares.clear();
+  _stop = NULL;
+  _trace = NULL;
+  _checkpoint = NULL;
+  _resuming = false;
+  _cost = -1;
+  _nConflicts = 0;
+  _conflictAge = 0;
 }
 
 Sudoku::~Sudoku() {}
@@ -49,102 +66,276 @@ Sudoku::~Sudoku() {}
 //  0: something went wrong while reading the file;
 // -1: only whit checkValidity set. loaded the instance, but it is not solvable.
 int Sudoku::loadInstance(const char* filename, bool checkValidity) {
+  MappedFile file;
+  if (filename == NULL) {  // if no filename is given, will try to read stdin
+    return loadInstance(stdin, checkValidity);
+  }
+  if (!file.open(filename)) {
+    printf("Failed to read file \"%s\"\n", filename);
+    return failLoad();
+  }
+  if (Corpus::isCorpus(file.data(), file.size())) {  // first of a corpus
+    Corpus corpus;
+    if (!corpus.open(file) || corpus.size() == 0) {
+      printf("Invalid corpus file \"%s\"\n", filename);
+      return failLoad();
+    }
+    const int loaded = corpus.load(0, this, checkValidity);
+    return loaded != 0 ? loaded : failLoad();
+  }
+  return loadInstanceText(file.data(), file.data() + file.size(), NULL,
+      checkValidity);
+}
+
+namespace {
+
+// Next integer of a stream, skipping whitespace (fscanf("%d") without the
+// format parsing and the locking). Returns false at EOF or on anything else.
+bool readInt(FILE* fin, int* value) {
+  int c, v = 0;
+  bool negative = false;
+  while ((c = getc_unlocked(fin)) == ' ' || c == '\t' || c == '\n'
+      || c == '\r') {}
+  if (c == '-') {
+    negative = true;
+    c = getc_unlocked(fin);
+  }
+  if (c < '0' || c > '9') {
+    if (c != EOF) ungetc(c, fin);
+    return false;
+  }
+  for (; c >= '0' && c <= '9'; c = getc_unlocked(fin)) {
+    if (v < 100000000) v = v*10 + (c - '0');
+  }
+  if (c != EOF) ungetc(c, fin);
+  *value = negative ? -v : v;
+  return true;
+}
+
+}  // namespace
+
+// Reads one instance from an already open stream, leaving it positioned right
+// after the instance, so concatenated instances can be read one at a time.
+// Same return values as above.
+int Sudoku::loadInstance(FILE* fin, bool checkValidity) {
   int buffer;
-  FILE* fin;
-  if (filename == '\0') {  // if no filename is given, will try to read stdin
-    fin = stdin;
-  } else {
-    fin = fopen(filename, "r");
-    if (fin == NULL) {
-      printf("Failed to read file \"%s\"\n", filename);
-      return 0;
+  if (!readInt(fin, &_order) || _order < 1 || _order >= 50) {
+    printf("Invalid board size.\n");
+    return failLoad();
+  }
+  _n = _order * _order;
+  _board.assign(_n*_n, 0);
+  _fixeds.assign(_n*_n, 0);
+  for (int k = 0; k < _n*_n; ++k) {
+    if (!readInt(fin, &buffer) || buffer > _n || buffer == 0
+        || buffer < -1) {
+      printf("Invalid value for cell (%d,%d).\n", k / _n, k % _n);
+      return failLoad();
     }
+    // empty cells (-1 in the file) are kept as 0 in memory
+    _board[k] = buffer > -1 ? buffer : 0;
+    _fixeds[k] = buffer > -1;
   }
-  if (fscanf(fin, "%d", &_order) != 1) {
+  return finishLoad(checkValidity);
+}
+
+// Same, from text in memory (e.g. a mapped file). If 'next' isn't NULL, it
+// gets the position right after the instance.
+int Sudoku::loadInstanceText(const char* begin, const char* end,
+    const char** next, bool checkValidity) {
+  const char* cursor = begin;
+  int buffer;
+  if (!parseInt(&cursor, end, &_order) || _order < 1 || _order >= 50) {
     printf("Invalid board size.\n");
-    return 0;
+    return failLoad();
   }
-  assert(_order > 0 && _order < 50);
   _n = _order * _order;
-  for (int i = 0; i < _n; ++i) {
-    _board.push_back(std::vector<int>());
-    _fixeds.push_back(std::vector<bool>());
-    for (int j = 0; j < _n; ++j) {
-      fscanf(fin, "%d", &buffer);
-      _board[i].push_back(buffer);
-      _fixeds[i].push_back(buffer > -1);
+  _board.assign(_n*_n, 0);
+  _fixeds.assign(_n*_n, 0);
+  for (int k = 0; k < _n*_n; ++k) {
+    if (!parseInt(&cursor, end, &buffer) || buffer > _n || buffer == 0
+        || buffer < -1) {
+      printf("Invalid value for cell (%d,%d).\n", k / _n, k % _n);
+      return failLoad();
     }
+    _board[k] = buffer > -1 ? buffer : 0;
+    _fixeds[k] = buffer > -1;
   }
-  if (!checkValidity) {
-    return 1;
-  } else {
-    //                / true, if 'w' was already used in the current square
-    // usedNumbers[w]|
-    //                \ false otherwise.
-    std::vector<bool> usedNumbers;
+  if (next != NULL) *next = cursor;
+  return finishLoad(checkValidity);
+}
 
-    // check rows
-    for (int i = 0; i < _n; ++i) {
-      usedNumbers = std::vector<bool>(_n+1, false);
-      for (int j = 0; j < _n; ++j) {
-        if (isCellFixed(i, j)) {
-          // already used this number in this row?
-          if (usedNumbers[_board[i][j]]) {
-            printf("\nr(%d,%d)\n", i, j);
-            return -1;
-          } else {
-            usedNumbers[_board[i][j]] = true;
-          }
-        }
-      }
+// Same, from the packed givens of a binary corpus (see instance_io.h):
+// n^2 cells of 'cellBytes' bytes each, 0 for the empty ones.
+int Sudoku::loadPacked(int order, const void* cells, int cellBytes,
+    bool checkValidity) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(cells);
+  if (order < 1 || order >= 50) {
+    printf("Invalid board size.\n");
+    return failLoad();
+  }
+  _order = order;
+  _n = _order * _order;
+  _board.resize(_n*_n);
+  _fixeds.resize(_n*_n);
+  for (int k = 0; k < _n*_n; ++k) {
+    int v;
+    if (cellBytes == 1) {
+      v = bytes[k];
+    } else {
+      uint16_t w;
+      memcpy(&w, bytes + 2*k, 2);
+      v = w;
     }
-    // check columns
-    for (int j = 0; j < _n; ++j) {
-      usedNumbers = std::vector<bool>(_n+1, false);
-      for (int i = 0; i < _n; ++i) {
-        if (isCellFixed(i, j)) {
-          // already used this number in this column?
-          if (usedNumbers[_board[i][j]]) {
-            printf("\nc(%d,%d)\n", i, j);
-            return -1;
-          } else {
-            usedNumbers[_board[i][j]] = true;
-          }
-        }
-      }
+    if (v > _n) {
+      printf("Invalid value for cell (%d,%d).\n", k / _n, k % _n);
+      return failLoad();
+    }
+    _board[k] = v;
+    _fixeds[k] = v > 0;
+  }
+  return finishLoad(checkValidity);
+}
+
+// Same, from memory: 'cells' holds order^4 values, row-major, with -1 (or 0)
+// for the empty ones.
+int Sudoku::loadInstance(int order, const int* cells, bool checkValidity) {
+  if (order < 1 || order >= 50) {
+    printf("Invalid board size.\n");
+    return failLoad();
+  }
+  _order = order;
+  _n = _order * _order;
+  _board.assign(_n*_n, 0);
+  _fixeds.assign(_n*_n, 0);
+  for (int k = 0; k < _n*_n; ++k) {
+    if (cells[k] > _n || cells[k] < -1) {
+      printf("Invalid value for cell (%d,%d).\n", k / _n, k % _n);
+      return failLoad();
     }
-    return 1;
+    _board[k] = cells[k] > 0 ? cells[k] : 0;
+    _fixeds[k] = cells[k] > 0;
+  }
+  return finishLoad(checkValidity);
+}
+
+// Common tail of the loaders, once _order, _board and _fixeds are set: builds
+// the indexes, sizes the scratch buffers, keeps the givens and, if asked,
+// checks that no row, column or square repeats a given.
+int Sudoku::finishLoad(bool checkValidity) {
+  int repeated;
+  _candidates.clear();
+  _resuming = false;
+  _givens = _board;
+  _scratch.assign(_n+1, 0);
+  _unitMasks.assign(bitboardScratchSize(_order), 0);
+  buildFreeCellIndex();
+  if (!checkValidity) return 1;
+  // empty cells are 0 here, so only the givens are checked
+  repeated = findRepeatedValue(&_board[0], _order, &_unitMasks[0]);
+  if (repeated >= 0) {
+    printf("\nrepeated given at (%d,%d)\n", repeated / _n, repeated % _n);
+    return -1;
   }
+  return 1;
+}
+
+// Failure path of the loaders: whatever was parsed so far belongs to no
+// instance, so the solver goes back to having none (order -1) instead of
+// mixing the new board with the old indexes. Keeps the buffers. Returns 0.
+int Sudoku::failLoad() {
+  _order = -1;
+  _n = -1;
+  _board.clear();
+  _fixeds.clear();
+  _givens.clear();
+  _candidates.clear();
+  _freeCells.clear();
+  _squareStart.clear();
+  _movableSquares.clear();
+  _resuming = false;
+  _cost = -1;
+  return 0;
+}
+
+int Sudoku::setBoard(const TBoard& board) {
+  std::copy(board.begin(), board.end(), _board.begin());
+  _cost = buildOccurrenceTables();
+  return _cost;
+}
+
+// Puts the board back as it was loaded (or as presolve() left it) and drops
+// the search state. Reuses every buffer.
+void Sudoku::reset() {
+  std::copy(_givens.begin(), _givens.end(), _board.begin());
+  _cost = -1;
+  _resuming = false;
 }
 
 bool Sudoku::isCellFixed(int i, int j) {
   assert(_order > 0);
   assert(i >= 0 && i < _n);
   assert(j >= 0 && j < _n);
-  return _fixeds[i][j];
+  return _fixeds[i*_n + j];
+}
+
+// Squares are numbered row-major (square 's' spans rows
+// (s / order)*order .. +order-1 and columns (s % order)*order .. +order-1).
+void Sudoku::buildFreeCellIndex() {
+  _freeCells.clear();
+  _squareStart.assign(_n+1, 0);
+  _movableSquares.clear();
+  for (int s = 0; s < _n; ++s) {
+    _squareStart[s] = _freeCells.size();
+    for (int p = 0; p < _order; ++p) {
+      for (int q = 0; q < _order; ++q) {
+        int i = (s / _order)*_order + p;
+        int j = (s % _order)*_order + q;
+        if (!_fixeds[i*_n + j]) _freeCells.push_back(i*_n + j);
+      }
+    }
+    if (_freeCells.size() - _squareStart[s] >= 2) _movableSquares.push_back(s);
+  }
+  _squareStart[_n] = _freeCells.size();
+  _conflictable.assign(_n*_n, 0);
+  for (size_t m = 0; m < _movableSquares.size(); ++m) {
+    const int sq = _movableSquares[m];
+    for (int k = _squareStart[sq]; k < _squareStart[sq+1]; ++k) {
+      _conflictable[_freeCells[k]] = 1;
+    }
+  }
+  _changedCells.resize(_n*_n);
+  _cellChanged.assign(_n*_n, 0);
+  _nChanged = 0;
+  _allChanged = true;
 }
 
 // Generate an initial solution, respecting:
 //  1.  The fixed cells and
 //  2.  The third restriction of the game, which constraints each order*order
 //      square to have each integer in [1, n^2] exactly once.
+// After presolve(), the free cells of each square are instead matched to the
+// missing values using their candidates (see fillSquareFromCandidates).
 void Sudoku::genInitSolution() {
-  //                / true, if 'w' was already used in the current square
-  // usedNumbers[w]|
-  //                \ false otherwise.
-  std::vector<bool> usedNumbers;
+  if (!_candidates.empty()) {
+    for (int sq = 0; sq < _n; ++sq) fillSquareFromCandidates(sq);
+    return;
+  }
+  // _scratch[w] == mark: 'w' was already used in the current square
+  int mark = 0;
   int x;
   int aux = 0;
+  std::fill(_scratch.begin(), _scratch.end(), 0);
   for (int i = 0; i < _order; ++i) {        // vertical position of the square
     for (int j = 0; j < _order; ++j) {      // horizontal position of the square
-      usedNumbers = std::vector<bool>(_n+1, false);
+      ++mark;
 
       // loop to find fixed values inside this square (i,j)
       for (int p = 0; p < _order; ++p) {    // line inside the square
         for (int q = 0; q < _order; ++q) {  // column inside the square
           if (isCellFixed(_order*i + p, _order*j + q)) {
-            aux = _board[_order*i + p][_order*j + q];
-            usedNumbers[aux] = true;
+            aux = cell(_order*i + p, _order*j + q);
+            _scratch[aux] = mark;
             // printf("pos(%d,%d) = %d (fixed)\n",
             //   _order*i + p, _order*j + q, aux);
           }
@@ -159,13 +350,13 @@ void Sudoku::genInitSolution() {
           if (!isCellFixed(_order*i + p, _order*j + q)) {
             aux = (x % _n) + 1;  // candidate value to fill the cell
             // printf("pos(%d,%d) = %d\n", _order*i + p, _order*j + q, aux);
-            while (usedNumbers[aux]) {  // find the first available value.
+            while (_scratch[aux] == mark) {  // find the first available value.
               aux = (++x % _n) + 1;     // note: it may not entry here if
                                         // the candidate was ok.
               // printf("x=%d;", x);
             }
-            _board[_order*i + p][_order*j + q] = aux;
-            usedNumbers[aux] = true;
+            _board[(_order*i + p)*_n + _order*j + q] = aux;
+            _scratch[aux] = mark;
             ++x;
           }
         }
@@ -174,13 +365,403 @@ void Sudoku::genInitSolution() {
   }
 }
 
+// *************
+// * presolve  *
+// *************
+// Candidates are kept as bitmasks (bit v-1 set if value v is still possible),
+// so presolve only runs for n <= 64, i.e. orders up to 8.
+
+namespace {
+
+inline int popcount64(uint64_t x) { return __builtin_popcountll(x); }
+inline int lowestValue(uint64_t x) { return __builtin_ctzll(x) + 1; }
+
+}  // namespace
+
+// Places value v at cell k for good: fixes it and removes v from the
+// candidates of every cell sharing its row, column or square.
+// Returns false if some peer is left without candidates.
+bool Sudoku::presolvePlace(int k, int v) {
+  const int i = k / _n, j = k % _n;
+  const int si = (i / _order)*_order, sj = (j / _order)*_order;
+  const uint64_t bit = 1ULL << (v-1);
+  bool ok = true;
+  _board[k] = v;
+  _fixeds[k] = 1;
+  _candidates[k] = bit;
+  for (int t = 0; t < _n; ++t) {
+    int peers[3] = { i*_n + t, t*_n + j,
+      (si + t / _order)*_n + sj + t % _order };
+    for (int w = 0; w < 3; ++w) {
+      int c = peers[w];
+      if (c == k || !(_candidates[c] & bit)) continue;
+      _candidates[c] &= ~bit;
+      if (_candidates[c] == 0) ok = false;
+    }
+  }
+  return ok;
+}
+
+// Cell index of the t-th cell of unit u. Units 0..n-1 are the rows, n..2n-1
+// the columns and 2n..3n-1 the squares.
+int Sudoku::unitCell(int u, int t) {
+  if (u < _n) return u*_n + t;
+  if (u < 2*_n) return t*_n + (u - _n);
+  u -= 2*_n;
+  return ((u / _order)*_order + t / _order)*_n + (u % _order)*_order
+    + t % _order;
+}
+
+// Constraint propagation on the givens, repeated until nothing changes:
+//  - naked singles: a free cell with a single candidate gets it;
+//  - hidden singles: a value that fits in a single cell of a unit goes there;
+//  - square/line reductions: if, inside a square, a value only fits in one
+//    row (column), it can't go anywhere else in that row (column); and if,
+//    inside a row (column), it only fits in one square, it can't go anywhere
+//    else in that square.
+// Forced cells become fixed. The remaining candidates are kept for
+// genInitSolution. Returns how many cells got fixed, or -1 if the instance
+// turned out to be unsolvable (including givens repeated in a unit).
+int Sudoku::presolve() {
+  const uint64_t all = _n == 64 ? ~0ULL : (1ULL << _n) - 1;
+  int placed = 0;
+  bool changed = true;
+
+  if (_n > 64) return 0;
+  _candidates.assign(_n*_n, all);
+  _matchCellOf.resize(_n+1);
+  _matchValueOf.resize(_n);
+  _matchParent.resize(_n);
+  _matchTried.resize(_n);
+  _matchStack.reserve(_n);
+
+  // givens: check for repeated values, then propagate them
+  for (int u = 0; u < 3*_n; ++u) {
+    uint64_t seen = 0;
+    for (int t = 0; t < _n; ++t) {
+      int c = unitCell(u, t);
+      if (!_fixeds[c]) continue;
+      uint64_t bit = 1ULL << (_board[c]-1);
+      if (seen & bit) {
+        _candidates.clear();
+        return -1;
+      }
+      seen |= bit;
+    }
+  }
+  for (int k = 0; k < _n*_n; ++k) {
+    if (_fixeds[k] && !presolvePlace(k, _board[k])) {
+      _candidates.clear();
+      return -1;
+    }
+  }
+
+  while (changed) {
+    changed = false;
+
+    // naked singles
+    for (int k = 0; k < _n*_n; ++k) {
+      if (_fixeds[k]) continue;
+      if (_candidates[k] == 0) {
+        _candidates.clear();
+        return -1;
+      }
+      if (popcount64(_candidates[k]) == 1) {
+        if (!presolvePlace(k, lowestValue(_candidates[k]))) {
+          _candidates.clear();
+          return -1;
+        }
+        ++placed;
+        changed = true;
+      }
+    }
+
+    // hidden singles
+    for (int u = 0; u < 3*_n; ++u) {
+      uint64_t once = 0, twice = 0, done = 0;
+      for (int t = 0; t < _n; ++t) {
+        int c = unitCell(u, t);
+        if (_fixeds[c]) {
+          done |= _candidates[c];
+        } else {
+          twice |= once & _candidates[c];
+          once |= _candidates[c];
+        }
+      }
+      if ((once | done) != all) {  // some value fits nowhere in this unit
+        _candidates.clear();
+        return -1;
+      }
+      uint64_t singles = once & ~twice & ~done;
+      for (int t = 0; t < _n && singles; ++t) {
+        int c = unitCell(u, t);
+        if (_fixeds[c] || !(_candidates[c] & singles)) continue;
+        uint64_t bit = _candidates[c] & singles;
+        if (popcount64(bit) > 1) {  // two values need this same cell
+          _candidates.clear();
+          return -1;
+        }
+        singles &= ~bit;
+        if (!presolvePlace(c, lowestValue(bit))) {
+          _candidates.clear();
+          return -1;
+        }
+        ++placed;
+        changed = true;
+      }
+    }
+
+    // square/line reductions
+    for (int sq = 0; sq < _n; ++sq) {
+      const int si = (sq / _order)*_order, sj = (sq % _order)*_order;
+      for (int v = 1; v <= _n; ++v) {
+        const uint64_t bit = 1ULL << (v-1);
+        int row = -1, col = -1;
+        bool oneRow = true, oneCol = true, any = false;
+        for (int t = 0; t < _n; ++t) {
+          int c = unitCell(2*_n + sq, t);
+          if (_fixeds[c] || !(_candidates[c] & bit)) continue;
+          if (any && row != c / _n) oneRow = false;
+          if (any && col != c % _n) oneCol = false;
+          row = c / _n;
+          col = c % _n;
+          any = true;
+        }
+        if (!any) continue;
+        for (int t = 0; t < _n; ++t) {
+          // pointing: eliminate from the rest of the row/column
+          if (oneRow && (t < sj || t >= sj + _order)) {
+            int c = row*_n + t;
+            if (!_fixeds[c] && (_candidates[c] & bit)) {
+              _candidates[c] &= ~bit;
+              changed = true;
+            }
+          }
+          if (oneCol && (t < si || t >= si + _order)) {
+            int c = t*_n + col;
+            if (!_fixeds[c] && (_candidates[c] & bit)) {
+              _candidates[c] &= ~bit;
+              changed = true;
+            }
+          }
+        }
+      }
+    }
+    for (int u = 0; u < 2*_n; ++u) {  // claiming, from rows and columns
+      for (int v = 1; v <= _n; ++v) {
+        const uint64_t bit = 1ULL << (v-1);
+        int sq = -1;
+        bool oneSquare = true;
+        for (int t = 0; t < _n && oneSquare; ++t) {
+          int c = unitCell(u, t);
+          if (_fixeds[c] || !(_candidates[c] & bit)) continue;
+          int cs = (c / _n / _order)*_order + (c % _n) / _order;
+          if (sq >= 0 && cs != sq) oneSquare = false;
+          sq = cs;
+        }
+        if (sq < 0 || !oneSquare) continue;
+        for (int t = 0; t < _n; ++t) {
+          int c = unitCell(2*_n + sq, t);
+          bool inLine = u < _n ? c / _n == u : c % _n == u - _n;
+          if (!inLine && !_fixeds[c] && (_candidates[c] & bit)) {
+            _candidates[c] &= ~bit;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  buildFreeCellIndex();
+  _givens = _board;
+  return placed;
+}
+
+// Fills the free cells of square 'sq' with the values missing from it,
+// preferring for each cell a value that is still one of its candidates.
+// It's a bipartite matching (cells x missing values, edges = candidates),
+// found with augmenting paths; cells left unmatched get whatever is left.
+// Works on buffers sized by presolve(), so it doesn't allocate.
+void Sudoku::fillSquareFromCandidates(int sq) {
+  const int begin = _squareStart[sq], end = _squareStart[sq+1];
+  const int k = end - begin;
+  uint64_t missing = _n == 64 ? ~0ULL : (1ULL << _n) - 1;
+  std::vector<int>& cellOf = _matchCellOf;    // free cell holding value v
+  std::vector<int>& valueOf = _matchValueOf;  // value of free cell c
+  std::vector<int>& stack = _matchStack;
+  std::vector<int>& parentValue = _matchParent;
+  std::vector<uint64_t>& tried = _matchTried;
+  std::fill(cellOf.begin(), cellOf.end(), -1);
+  std::fill(valueOf.begin(), valueOf.begin() + k, 0);
+
+  for (int t = 0; t < _n; ++t) {
+    int c = unitCell(2*_n + sq, t);
+    if (_fixeds[c]) missing &= ~(1ULL << (_board[c]-1));
+  }
+
+  for (int c = 0; c < k; ++c) {
+    // augmenting path search from cell c (iterative DFS)
+    int found = 0;
+    stack.assign(1, c);
+    std::fill(parentValue.begin(), parentValue.begin() + k, 0);
+    std::fill(tried.begin(), tried.begin() + k, 0);
+    while (!stack.empty() && found == 0) {
+      int x = stack.back();
+      uint64_t options = _candidates[_freeCells[begin + x]] & missing
+        & ~tried[x];
+      if (options == 0) {
+        stack.pop_back();
+        continue;
+      }
+      int v = lowestValue(options);
+      tried[x] |= 1ULL << (v-1);
+      if (cellOf[v] < 0) {
+        found = v;
+      } else if (tried[cellOf[v]] == 0 && cellOf[v] != c) {
+        parentValue[cellOf[v]] = v;
+        stack.push_back(cellOf[v]);
+      }
+    }
+    // flip the path: each cell on the stack takes the value that led on
+    for (int v = found; v != 0 && !stack.empty(); stack.pop_back()) {
+      int x = stack.back();
+      int previous = parentValue[x];
+      cellOf[v] = x;
+      valueOf[x] = v;
+      v = previous;
+    }
+  }
+
+  // unmatched cells get the values nobody took
+  for (int v = 1, c = 0; v <= _n; ++v) {
+    if (!(missing & (1ULL << (v-1))) || cellOf[v] >= 0) continue;
+    while (valueOf[c] != 0) ++c;
+    valueOf[c] = v;
+  }
+  for (int c = 0; c < k; ++c) _board[_freeCells[begin + c]] = valueOf[c];
+}
+
+// CPU time of the calling thread, so that solvers running side by side don't
+// count each other's time. Falls back to the process' clock() elsewhere.
+double threadCpuSeconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+#endif
+  return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+}
+
+// Hot-loop helpers. 'n' is passed in so that, when called from sweep<kOrder>,
+// the compiler sees it as a constant and folds the index arithmetic.
+namespace {
+
+inline void swapAndCount(TCell* board, TCount* rowCount, TCount* colCount,
+    int n,
+    int i1, int j1, int i2, int j2) {
+  const int a = board[i1*n + j1];
+  const int b = board[i2*n + j2];
+  if (i1 != i2) {
+    --rowCount[i1*(n+1) + a]; ++rowCount[i1*(n+1) + b];
+    --rowCount[i2*(n+1) + b]; ++rowCount[i2*(n+1) + a];
+  }
+  if (j1 != j2) {
+    --colCount[j1*(n+1) + a]; ++colCount[j1*(n+1) + b];
+    --colCount[j2*(n+1) + b]; ++colCount[j2*(n+1) + a];
+  }
+  board[i1*n + j1] = b;
+  board[i2*n + j2] = a;
+}
+
+// True if the value of cell c (as i*n + j) repeats in its row or column.
+inline bool isConflicting(const TCell* board, const TCount* rowCount,
+    const TCount* colCount, int n, int c) {
+  const int v = board[c];
+  return rowCount[(c / n)*(n+1) + v] > 1 || colCount[(c % n)*(n+1) + v] > 1;
+}
+
+// Adds cell c to the conflict set if it is conflicting and not there yet.
+inline void noteConflict(const TCell* board, const TCount* rowCount,
+    const TCount* colCount, int n, int c, int* conflicts,
+    uint8_t* inConflicts, int* nConflicts) {
+  if (!inConflicts[c] && isConflicting(board, rowCount, colCount, n, c)) {
+    inConflicts[c] = 1;
+    conflicts[(*nConflicts)++] = c;
+  }
+}
+
+// Value v was just doubled in the line of n cells starting at cell 'first',
+// 'stride' apart, by a move into cell 'moved': adds the cell that already
+// held it to the conflict set, if it may be there (see _conflictable).
+inline void notePartner(const TCell* board, int n, int first, int stride,
+    int v, int moved, const uint8_t* conflictable, int* conflicts,
+    uint8_t* inConflicts, int* nConflicts) {
+  for (int t = 0, c = first; t < n; ++t, c += stride) {
+    if (board[c] != v || c == moved) continue;
+    if (conflictable[c] && !inConflicts[c]) {
+      inConflicts[c] = 1;
+      conflicts[(*nConflicts)++] = c;
+    }
+    return;
+  }
+}
+
+// Adds cell c to the set of cells changed since the last saveBest().
+inline void noteChanged(int c, int* changed, uint8_t* cellChanged,
+    int* nChanged) {
+  if (!cellChanged[c]) {
+    cellChanged[c] = 1;
+    changed[(*nChanged)++] = c;
+  }
+}
+
+inline int deltaFromCounts(const TCell* board, const TCount* rowCount,
+    const TCount* colCount, int n, int i1, int j1, int i2, int j2) {
+  const int a = board[i1*n + j1];
+  const int b = board[i2*n + j2];
+  int delta = 0;
+  if (a == b) return 0;
+  if (i1 != i2) {
+    const TCount* r1 = rowCount + i1*(n+1);
+    const TCount* r2 = rowCount + i2*(n+1);
+    delta += (r1[a] > 1 ? -1 : 0) + (r1[b] > 0 ? 1 : 0)
+           + (r2[b] > 1 ? -1 : 0) + (r2[a] > 0 ? 1 : 0);
+  }
+  if (j1 != j2) {
+    const TCount* c1 = colCount + j1*(n+1);
+    const TCount* c2 = colCount + j2*(n+1);
+    delta += (c1[a] > 1 ? -1 : 0) + (c1[b] > 0 ? 1 : 0)
+           + (c2[b] > 1 ? -1 : 0) + (c2[a] > 0 ? 1 : 0);
+  }
+  return delta;
+}
+
+}  // namespace
+
 void Sudoku::swapCells(int i1, int j1, int i2, int j2) {
   // swap only if they're not fixed
   if (!isCellFixed(i1, j1) && !isCellFixed(i2, j2)) {
-    std::swap(_board[i1][j1], _board[i2][j2]);
+    if (_rowCount.empty()) {  // occurrence tables not built yet
+      std::swap(_board[i1*_n + j1], _board[i2*_n + j2]);
+    } else {
+      swapAndCount(&_board[0], &_rowCount[0], &_colCount[0], _n,
+          i1, j1, i2, j2);
+    }
   }
 }
 
+// Computes how much the cost would change if (i1,j1) and (i2,j2) got swapped,
+// without touching the board. Value 'a' leaves line 1 and enters line 2, while
+// 'b' does the opposite, so:
+//  - removing a value from a line where it is repeated saves 1;
+//  - adding a value to a line where it already exists costs 1.
+// Lines shared by both cells don't change at all.
+int Sudoku::swapDelta(int i1, int j1, int i2, int j2) {
+  return deltaFromCounts(&_board[0], &_rowCount[0], &_colCount[0], _n,
+      i1, j1, i2, j2);
+}
+
 // Solve current board using Simulated Annealing.
 // Outputs are:
 //  initialSolution : value of the first generated solution;
@@ -189,76 +770,969 @@ void Sudoku::swapCells(int i1, int j1, int i2, int j2) {
 bool Sudoku::solve(float initialTemp, float alpha, int stagesLength,
     unsigned int randomSeed, int* initialSolution, int* finalSolution,
     double* seconds) {
-  // cell selection variables
-  int i, j;             // selected square
-  int p1, q1, p2, q2;   // selected cells (p1,q1) and (p2,q2)
-  // simulated annealing variables
-  int curSolution, candidateSolution, deltaS;
-  float temperature;
-  double prob, r;
-  // runtime measurement variables
-  clock_t begin, end;
+  SAParams params;
+  SAResult result;
+  params.initialTemp = initialTemp;
+  params.alpha = alpha;
+  params.stagesLength = stagesLength;
+  params.randomSeed = randomSeed;
+  solve(params, &result);
+  *initialSolution = result.initialSolution;
+  *finalSolution = result.finalSolution;
+  *seconds = result.cpuSeconds;
+  return result.status == kSolved;
+}
 
-  begin = clock();
+// Geometric cooling (temperature *= alpha every stagesLength proposals) until
+// cost 0, the stop flag or some budget. If the cost doesn't improve for
+// stallStages stages, the search is reheated, or with restart the free cells
+// get shuffled and it starts over from initialTemp (see StageSchedule). The
+// best board seen at the end of a stage is kept, and restored if the search
+// ends above it. With rejectionFree, stages accepting less than
+// rejectionFreeBelow of their proposals switch the search to
+// rejectionFreeSweep() until the next reheat, and after a reheat only once
+// the search had stallStages stages of its own; proposals then count the
+// ones it stands for.
+bool Sudoku::solve(const SAParams& params, SAResult* result) {
+  typedef std::chrono::steady_clock Clock;
+  // checking the clock every stage would be too much for short stages
+  const long long kClockCheckInterval = 4096;
+  Clock::time_point begin = Clock::now();
+  double cpuBegin = threadCpuSeconds();
+  uint64_t acceptThreshold[kMaxSwapDelta+1];
+  uint64_t conflictThreshold = 0;
+  StageSchedule schedule;
+  float initialTemp = params.initialTemp;
+  float alpha = params.alpha;
+  int stagesLength = params.stagesLength;
+  int stage = 0;
+  long long sinceClockCheck = 0;
+  bool rejectionFree = false;   // in the cold phase, see rejectionFreeSweep
+  bool canRejectionFree = params.rejectionFree;
+#ifdef SUDOKU_TELEMETRY
+  TraceRecord record;
+  StageStats traced;    // counters since the last trace record
+#endif
+  if (params.moves == kConflictMoves) {
+    conflictThreshold = static_cast<uint64_t>(
+        std::min(std::max(params.conflictBias, 0.0f), 1.0f) * 4294967296.0);
+  }
+  if (_resuming) {  // boards, engine and conflicts are in place already
+    const SAState& state = _resumeState;
+    _resuming = false;
+    schedule = state.schedule;
+    alpha = state.alpha;
+    stagesLength = state.stagesLength;
+    stage = state.stage;
+    rejectionFree = state.rejectionFree;
+    canRejectionFree = state.canRejectionFree;
+    *result = state.result;
+    begin -= std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(state.result.seconds));
+    cpuBegin -= state.result.cpuSeconds;
+    // its tables only depend on the board
+    if (rejectionFree) rejectionFree = buildRejectionFree();
+  } else {
+    result->proposals = 0;
+    result->accepted = 0;
+    result->uphillAccepted = 0;
+    result->reheats = 0;
+    result->initialSolution = startSearch(params.randomSeed);
+    _bestBoard = _board;
+    clearChanged();
+    if (params.adaptive) {
+      if (initialTemp <= 0) {
+        initialTemp = sampleInitialTemp(params.targetAcceptance);
+      }
+      if (stagesLength <= 0) {
+        stagesLength = std::max<int>(_freeCells.size(), 1);
+      }
+    }
+    schedule.start(initialTemp, _cost);
+    if (params.moves == kConflictMoves) rebuildConflicts();
+  }
+  result->status = kNoMoves;
 
-  genInitSolution();
-  temperature = initialTemp;
-  curSolution = evaluateCurrentSolution();
-  *initialSolution = curSolution;
-  srand(randomSeed);
-  while (curSolution > 0) {
-    // loop controling temperature stages length
-    for (int stageI = 0; stageI < stagesLength && curSolution > 0; ++stageI) {
-
-      // selection of the two non-fixed cells (in the same square)
-      // note: the way it ignores the selection may cause it to rarely deal with
-      //       squares containing very few non-fixeds.
-      do {
-        // select a square
-        i = rand() % _order;
-        j = rand() % _order;
-
-        // select two cells in the selected square
-        p1 = p2 = i*_order;
-        q1 = q2 = j*_order;
-        p1 += rand() % _order;
-        q1 += rand() % _order;
-        p2 += rand() % _order;
-        q2 += rand() % _order;
-      } while (isCellFixed(p1, q1) || isCellFixed(p2, q2));
-
-      // swap them
-      // printf("swapping (%d,%d) <-> (%d,%d)\n", p1, q1, p2, q2);
-      swapCells(p1, q1, p2, q2);
-      candidateSolution = evaluateCurrentSolution(); // todo: delta evaluation
-      // printf("from % 3d to % 3d\n", curSolution, candidateSolution);
-
-      if (candidateSolution <= curSolution) {
-        curSolution = candidateSolution;
-        // printf("solution updated to %d (BETTER)\n", curSolution);
+  while (_cost > params.targetCost && !_movableSquares.empty()) {
+    const float temperature = schedule.temperature;
+    int proposals;
+    if (rejectionFree) {
+      setRejectionFreeTemp(temperature);
+      proposals = rejectionFreeSweep(stagesLength);
+      // a stage costs O(n) at least, and accepted moves much more
+      sinceClockCheck = kClockCheckInterval;
+    } else {
+      buildAcceptTable(temperature, acceptThreshold);
+      proposals = runSweep(acceptThreshold, stagesLength, conflictThreshold);
+      sinceClockCheck += proposals;
+    }
+    result->proposals += proposals;
+    result->accepted += _stageStats.accepted;
+#ifdef SUDOKU_TELEMETRY
+    result->uphillAccepted += _stageStats.uphillAccepted;
+    record.temperature = temperature;
+#endif
+    if (params.adaptive && proposals > 0) {
+      alpha = adaptiveAlpha(static_cast<float>(_stageStats.accepted)
+          / proposals);
+    }
+    // after a reheat, only once the reheated search had a stall window of
+    // its own: a cold reheat would otherwise flip between the two modes
+    if (canRejectionFree && !rejectionFree && proposals > 0
+        && _stageStats.accepted < params.rejectionFreeBelow * proposals
+        && (result->reheats == 0
+          || schedule.warmStages >= params.stallStages)) {
+      rejectionFree = canRejectionFree = buildRejectionFree();
+    }
+
+    const StageEnd stageEnd = schedule.endStage(params, alpha, _cost);
+    switch (stageEnd) {
+      case kStageNewBest:
+        saveBest();
+        break;
+      case kStageRestart:
+        randomizeFreeCells();
+        // fall through
+      case kStageReheat:
+        if (conflictThreshold != 0 && (params.restart || rejectionFree)) {
+          rebuildConflicts();
+        }
+        rejectionFree = false;  // warm again
+        ++result->reheats;
+        break;
+      case kStageGoOn:
+        break;
+    }
+#ifdef SUDOKU_TELEMETRY
+    if (_trace != NULL) {
+      traced.proposals += _stageStats.proposals;
+      traced.accepted += _stageStats.accepted;
+      traced.uphillAccepted += _stageStats.uphillAccepted;
+      record.cost = _cost;
+      record.bestCost = schedule.bestCost;
+      record.stage = stage;
+      if (_trace->wants(stage, stageEnd == kStageNewBest)) {
+        std::chrono::duration<double> elapsed = Clock::now() - begin;
+        record.proposals = traced.proposals;
+        record.accepted = traced.accepted;
+        record.uphillAccepted = traced.uphillAccepted;
+        record.rejected = traced.proposals - traced.accepted;
+        record.seconds = elapsed.count();
+        _trace->write(record);
+        traced = StageStats();
+      }
+    }
+#endif
+    ++stage;
+
+    if (_cost <= params.targetCost) break;
+    bool checkpointDue = false;
+    if (_stop != NULL && _stop->load(std::memory_order_relaxed)) {
+      result->status = kStopped;
+    } else if (params.maxProposals > 0
+        && result->proposals >= params.maxProposals) {
+      result->status = kOutOfProposals;
+    } else if ((params.maxSeconds > 0 || _checkpoint != NULL)
+        && sinceClockCheck >= kClockCheckInterval) {
+      sinceClockCheck = 0;
+      std::chrono::duration<double> elapsed = Clock::now() - begin;
+      if (params.maxSeconds > 0 && elapsed.count() >= params.maxSeconds) {
+        result->status = kOutOfTime;
       } else {
-        deltaS = candidateSolution - curSolution;
-        prob = exp(-1*(deltaS/temperature));
-        r = static_cast<double>(rand()) / (RAND_MAX);
-        // printf("prob => e^-(%d/%f) = %f  |  r = %f\n",
-        //     deltaS, temperature, prob, r);
-        if ( r <= prob ) {
-          curSolution = candidateSolution;
-          // printf("solution updated to %d (PROB)\n", curSolution);
-        } else {
-          // swap back to place
-          swapCells(p1, q1, p2, q2);
+        checkpointDue = _checkpoint != NULL
+          && _checkpoint->due(elapsed.count());
+      }
+    }
+    // a run stopped by a budget or the stop flag can be resumed too
+    const bool ending = result->status != kNoMoves;
+    if (_checkpoint != NULL && (checkpointDue || ending)) {
+      std::chrono::duration<double> elapsed = Clock::now() - begin;
+      SAState state;
+      state.schedule = schedule;
+      state.alpha = alpha;
+      state.stagesLength = stagesLength;
+      state.stage = stage;
+      state.rejectionFree = rejectionFree;
+      state.canRejectionFree = canRejectionFree;
+      state.result = *result;
+      state.result.seconds = elapsed.count();
+      state.result.cpuSeconds = threadCpuSeconds() - cpuBegin;
+      saveCheckpoint(params, state);
+    }
+    if (ending) break;
+  }
+#ifdef SUDOKU_TELEMETRY
+  if (_trace != NULL && traced.proposals > 0) {  // the stages left unsampled
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    record.proposals = traced.proposals;
+    record.accepted = traced.accepted;
+    record.uphillAccepted = traced.uphillAccepted;
+    record.rejected = traced.proposals - traced.accepted;
+    record.seconds = elapsed.count();
+    _trace->write(record);
+  }
+#endif
+  if (_cost == 0) {
+    result->status = kSolved;
+  } else if (_cost <= params.targetCost) {
+    result->status = kReachedTarget;
+  } else if (_cost > schedule.bestCost) {
+    _board = _bestBoard;
+    _cost = buildOccurrenceTables();
+  }
+  assert(_cost == evaluateCurrentSolution());
+
+  std::chrono::duration<double> elapsed = Clock::now() - begin;
+  result->seconds = elapsed.count();
+  result->cpuSeconds = threadCpuSeconds() - cpuBegin;
+  result->finalSolution = _cost;
+  return result->status == kSolved;
+}
+
+void StageSchedule::start(float temp, int cost) {
+  temperature = initialTemp = bestTemp = temp;
+  bestCost = runBestCost = cost;
+  stall = reheatLevel = warmStages = 0;
+}
+
+StageEnd StageSchedule::endStage(const SAParams& params, float alpha,
+    int cost) {
+  const float stageTemp = temperature;
+  temperature *= alpha;
+  ++warmStages;
+  if (cost < runBestCost) {
+    runBestCost = cost;
+    bestTemp = stageTemp;
+    stall = reheatLevel = 0;
+    if (cost >= bestCost) return kStageGoOn;
+    bestCost = cost;
+    return kStageNewBest;
+  }
+  // still cooling down from a reheat: not stalled yet
+  if (params.stallStages <= 0 || stageTemp > bestTemp
+      || ++stall < params.stallStages) {
+    return kStageGoOn;
+  }
+  stall = warmStages = 0;
+  if (params.restart) {
+    // a new run: its first stage sets the baseline
+    temperature = initialTemp;
+    runBestCost = INT_MAX;
+    reheatLevel = 0;
+    return kStageRestart;
+  }
+  // a reheat that didn't help makes the next one warmer still
+  ++reheatLevel;
+  temperature = bestTemp;
+  for (int k = 0; k < reheatLevel && temperature < initialTemp; ++k) {
+    temperature *= kReheatFactor;
+  }
+  temperature = std::min(temperature, initialTemp);
+  runBestCost = cost;
+  return kStageReheat;
+}
+
+// Initial temperature for the adaptive schedule: samples random moves from
+// the current board (without making them) and finds, by bisection, the
+// temperature at which the expected share of accepted moves is
+// 'targetAcceptance'. Deltas are integers in [-kMaxSwapDelta, kMaxSwapDelta],
+// so a histogram of the uphill ones is all it needs.
+float Sudoku::sampleInitialTemp(float targetAcceptance) {
+  const int kSamples = 1000;
+  int uphill[kMaxSwapDelta+1] = { 0 };
+  int downhill = 0;
+  float low = 0.01, high = 100;
+  if (_movableSquares.empty()) return 1;
+  for (int t = 0; t < kSamples; ++t) {
+    int s = _movableSquares[_rng.below(_movableSquares.size())];
+    int k = _squareStart[s+1] - _squareStart[s];
+    int a = _rng.below(k), b = _rng.below(k-1);
+    if (b >= a) ++b;
+    a = _freeCells[_squareStart[s] + a];
+    b = _freeCells[_squareStart[s] + b];
+    int delta = swapDelta(a / _n, a % _n, b / _n, b % _n);
+    if (delta <= 0) {
+      ++downhill;
+    } else {
+      ++uphill[delta];
+    }
+  }
+  for (int step = 0; step < 40; ++step) {  // bisection in log scale
+    float mid = sqrt(low * high);
+    double accepted = downhill;
+    for (int d = 1; d <= kMaxSwapDelta; ++d) accepted += uphill[d]*exp(-d/mid);
+    if (accepted / kSamples < targetAcceptance) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return high;
+}
+
+// Cooling speed for the adaptive schedule, from the share of accepted moves
+// in the last stage: cool fast while nearly everything is accepted (the
+// board is just being shuffled), slowly in the range where the cost actually
+// comes down, and a bit faster again once the search is nearly frozen (the
+// stall reheating takes over from there).
+float Sudoku::adaptiveAlpha(float acceptance) {
+  if (acceptance > 0.5) return 0.8;
+  if (acceptance > 0.02) return 0.99;
+  return 0.95;
+}
+
+// Generates the initial solution, builds the occurrence tables and seeds the
+// random engine. Returns the initial cost.
+int Sudoku::startSearch(unsigned int randomSeed) {
+  genInitSolution();
+  _cost = buildOccurrenceTables();
+  _rng.seed(randomSeed);
+  return _cost;
+}
+
+// Random permutation (Fisher-Yates) of the free cells' values inside each
+// square, so every square keeps all of its values. Returns the new cost.
+int Sudoku::randomizeFreeCells() {
+  for (int sq = 0; sq < _n; ++sq) {
+    for (int k = _squareStart[sq+1] - 1; k > _squareStart[sq]; --k) {
+      int other = _squareStart[sq] + _rng.below(k - _squareStart[sq] + 1);
+      std::swap(_board[_freeCells[k]], _board[_freeCells[other]]);
+    }
+  }
+  _allChanged = true;
+  _cost = buildOccurrenceTables();
+  return _cost;
+}
+
+// Copies to _bestBoard the cells changed since the last copy, so a new best
+// costs at most two cells per move accepted since the previous one, instead
+// of a copy of the board.
+void Sudoku::saveBest() {
+  if (_allChanged) {
+    for (size_t k = 0; k < _freeCells.size(); ++k) {
+      _bestBoard[_freeCells[k]] = _board[_freeCells[k]];
+    }
+  } else {
+    for (int k = 0; k < _nChanged; ++k) {
+      _bestBoard[_changedCells[k]] = _board[_changedCells[k]];
+    }
+  }
+  clearChanged();
+}
+
+// Empties the set of changed cells (_bestBoard is up to date).
+void Sudoku::clearChanged() {
+  for (int k = 0; k < _nChanged; ++k) _cellChanged[_changedCells[k]] = 0;
+  _nChanged = 0;
+  _allChanged = false;
+}
+
+// Checkpoints (format in checkpoint.h). Values are copied as they are in
+// memory; a checkpoint is only meant to be read back by the same build.
+namespace {
+
+const char kCheckpointMagic[8] = { 'S', 'U', 'D', 'O', 'K', 'U', 'K', '2' };
+
+template <typename T>
+void putValue(std::vector<uint8_t>* out, const T& value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out->insert(out->end(), bytes, bytes + sizeof(value));
+}
+
+// Reads values back in the same order; every get() fails past the end.
+class CheckpointReader {
+  public:
+    explicit CheckpointReader(const std::vector<uint8_t>& data)
+      : _at(data.empty() ? NULL : &data[0]), _end(_at + data.size()) {}
+    template <typename T>
+    bool get(T* value) {
+      if (static_cast<size_t>(_end - _at) < sizeof(*value)) return false;
+      memcpy(value, _at, sizeof(*value));
+      _at += sizeof(*value);
+      return true;
+    }
+    // the fields stored with a fixed width
+    bool getInt(int* value) { return getAs<int32_t>(value); }
+    bool getUnsigned(unsigned int* value) { return getAs<uint32_t>(value); }
+    bool getLong(long long* value) { return getAs<int64_t>(value); }
+    bool getFlag(bool* value) {
+      uint8_t byte;
+      if (!get(&byte) || byte > 1) return false;
+      *value = byte != 0;
+      return true;
+    }
+    bool atEnd() const { return _at == _end; }
+  private:
+    template <typename Stored, typename T>
+    bool getAs(T* value) {
+      Stored stored;
+      if (!get(&stored)) return false;
+      *value = stored;
+      return true;
+    }
+    const uint8_t* _at;
+    const uint8_t* _end;
+};
+
+}  // namespace
+
+// FNV-1a of the givens (as loaded or presolved), to tell instances apart.
+uint64_t Sudoku::givensHash() const {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t c = 0; c < _givens.size(); ++c) {
+    hash = (hash ^ _givens[c]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+void Sudoku::saveCheckpoint(const SAParams& params, const SAState& state) {
+  uint64_t words[RandomEngine::kStateWords];
+  std::vector<uint8_t>* out = &_snapshot;
+  out->assign(kCheckpointMagic, kCheckpointMagic + 8);
+  putValue(out, static_cast<int32_t>(_order));
+  putValue(out, givensHash());
+
+  putValue(out, params.initialTemp);
+  putValue(out, params.alpha);
+  putValue(out, static_cast<int32_t>(params.stagesLength));
+  putValue(out, static_cast<uint32_t>(params.randomSeed));
+  putValue(out, params.maxSeconds);
+  putValue(out, static_cast<int64_t>(params.maxProposals));
+  putValue(out, static_cast<int32_t>(params.stallStages));
+  putValue(out, static_cast<uint8_t>(params.restart));
+  putValue(out, static_cast<int32_t>(params.targetCost));
+  putValue(out, static_cast<uint8_t>(params.adaptive));
+  putValue(out, params.targetAcceptance);
+  putValue(out, static_cast<int32_t>(params.moves));
+  putValue(out, params.conflictBias);
+  putValue(out, static_cast<uint8_t>(params.rejectionFree));
+  putValue(out, params.rejectionFreeBelow);
+
+  putValue(out, state.schedule.temperature);
+  putValue(out, state.schedule.initialTemp);
+  putValue(out, state.schedule.bestTemp);
+  putValue(out, static_cast<int32_t>(state.schedule.bestCost));
+  putValue(out, static_cast<int32_t>(state.schedule.runBestCost));
+  putValue(out, static_cast<int32_t>(state.schedule.stall));
+  putValue(out, static_cast<int32_t>(state.schedule.reheatLevel));
+  putValue(out, static_cast<int32_t>(state.schedule.warmStages));
+  putValue(out, state.alpha);
+  putValue(out, static_cast<int32_t>(state.stagesLength));
+  putValue(out, static_cast<int32_t>(state.stage));
+  putValue(out, static_cast<uint8_t>(state.rejectionFree));
+  putValue(out, static_cast<uint8_t>(state.canRejectionFree));
+  putValue(out, static_cast<int32_t>(state.result.initialSolution));
+  putValue(out, static_cast<int64_t>(state.result.proposals));
+  putValue(out, static_cast<int64_t>(state.result.accepted));
+  putValue(out, static_cast<int64_t>(state.result.uphillAccepted));
+  putValue(out, static_cast<int32_t>(state.result.reheats));
+  putValue(out, state.result.seconds);
+  putValue(out, state.result.cpuSeconds);
+
+  _rng.getState(words);
+  putValue(out, static_cast<int32_t>(RandomEngine::kStateWords));
+  for (int k = 0; k < RandomEngine::kStateWords; ++k) putValue(out, words[k]);
+
+  putValue(out, static_cast<int32_t>(_freeCells.size()));
+  for (size_t k = 0; k < _freeCells.size(); ++k) {
+    putValue(out, static_cast<uint16_t>(_board[_freeCells[k]]));
+  }
+  for (size_t k = 0; k < _freeCells.size(); ++k) {
+    putValue(out, static_cast<uint16_t>(_bestBoard[_freeCells[k]]));
+  }
+
+  putValue(out, static_cast<int64_t>(_conflictAge));
+  putValue(out, static_cast<int32_t>(_nConflicts));
+  for (int k = 0; k < _nConflicts; ++k) {
+    putValue(out, static_cast<int32_t>(_conflictCells[k]));
+  }
+  _checkpoint->submit(out, state.result.seconds);
+}
+
+int Sudoku::loadCheckpoint(const std::vector<uint8_t>& data,
+    SAParams* params) {
+  CheckpointReader in(data);
+  SAParams p;
+  SAState st;
+  char magic[8];
+  int order, moves = kRandomMoves, words, freeCells, nConflicts, cell;
+  uint64_t hash, state[RandomEngine::kStateWords];
+  long long conflictAge;
+  bool ok = true;
+
+  for (int k = 0; k < 8; ++k) ok = ok && in.get(&magic[k]);
+  if (!ok || memcmp(magic, kCheckpointMagic, 8) != 0) return 0;
+  if (!in.getInt(&order) || !in.get(&hash)) return 0;
+  if (order != _order || hash != givensHash()) return -1;
+
+  ok = in.get(&p.initialTemp) && in.get(&p.alpha)
+    && in.getInt(&p.stagesLength) && in.getUnsigned(&p.randomSeed)
+    && in.get(&p.maxSeconds) && in.getLong(&p.maxProposals)
+    && in.getInt(&p.stallStages) && in.getFlag(&p.restart)
+    && in.getInt(&p.targetCost) && in.getFlag(&p.adaptive)
+    && in.get(&p.targetAcceptance) && in.getInt(&moves)
+    && (moves == kRandomMoves || moves == kConflictMoves)
+    && in.get(&p.conflictBias) && in.getFlag(&p.rejectionFree)
+    && in.get(&p.rejectionFreeBelow);
+  p.moves = static_cast<MovePolicy>(moves);
+  ok = ok && in.get(&st.schedule.temperature)
+    && in.get(&st.schedule.initialTemp) && in.get(&st.schedule.bestTemp)
+    && in.getInt(&st.schedule.bestCost) && in.getInt(&st.schedule.runBestCost)
+    && in.getInt(&st.schedule.stall) && in.getInt(&st.schedule.reheatLevel)
+    && in.getInt(&st.schedule.warmStages)
+    && in.get(&st.alpha) && in.getInt(&st.stagesLength)
+    && in.getInt(&st.stage)
+    && in.getFlag(&st.rejectionFree) && in.getFlag(&st.canRejectionFree)
+    && in.getInt(&st.result.initialSolution)
+    && in.getLong(&st.result.proposals) && in.getLong(&st.result.accepted)
+    && in.getLong(&st.result.uphillAccepted)
+    && in.getInt(&st.result.reheats)
+    && in.get(&st.result.seconds) && in.get(&st.result.cpuSeconds);
+  ok = ok && in.getInt(&words) && words == RandomEngine::kStateWords;
+  for (int k = 0; ok && k < RandomEngine::kStateWords; ++k) {
+    ok = in.get(&state[k]);
+  }
+  ok = ok && in.getInt(&freeCells)
+    && freeCells == static_cast<int>(_freeCells.size());
+  if (!ok) return 0;
+
+  // values go straight into the boards, which only matter if it all checks
+  std::vector<uint16_t> values(2 * freeCells);
+  for (int k = 0; ok && k < 2 * freeCells; ++k) {
+    ok = in.get(&values[k]) && values[k] >= 1 && values[k] <= _n;
+  }
+  ok = ok && in.getLong(&conflictAge) && in.getInt(&nConflicts)
+    && nConflicts >= 0 && nConflicts <= _n*_n;
+  if (!ok) return 0;
+  _conflictCells.resize(_n*_n);
+  _inConflicts.assign(_n*_n, 0);
+  for (int k = 0; ok && k < nConflicts; ++k) {
+    ok = in.getInt(&cell) && cell >= 0 && cell < _n*_n && _conflictable[cell]
+      && !_inConflicts[cell];
+    if (ok) {
+      _conflictCells[k] = cell;
+      _inConflicts[cell] = 1;
+    }
+  }
+  if (!ok || !in.atEnd()) {
+    _nConflicts = 0;
+    return 0;
+  }
+
+  _nConflicts = nConflicts;
+  _conflictAge = conflictAge;
+  _board = _givens;
+  _bestBoard = _givens;
+  for (int k = 0; k < freeCells; ++k) {
+    _board[_freeCells[k]] = values[k];
+    _bestBoard[_freeCells[k]] = values[freeCells + k];
+  }
+  _cost = buildOccurrenceTables();
+  // the next new best copies every free cell
+  _allChanged = true;
+  _rng.setState(state);
+  _resumeState = st;
+  _resuming = true;
+  *params = p;
+  return 1;
+}
+
+// Metropolis steps at a fixed temperature. Returns how many were made.
+int Sudoku::metropolis(float temperature, int steps) {
+  uint64_t acceptThreshold[kMaxSwapDelta+1];
+  if (_movableSquares.empty()) return 0;
+  buildAcceptTable(temperature, acceptThreshold);
+  return runSweep(acceptThreshold, steps, 0);
+}
+
+// acceptThreshold[d]: an uphill move of 'd' is accepted when 32 random bits
+// fall below it, i.e. with probability exp(-d/temperature). A move that
+// costs nothing is always taken; d starts at 1 so that temperature 0 gives
+// exp(-inf) = 0 rather than the NaN of 0/0.
+void Sudoku::buildAcceptTable(float temperature, uint64_t* acceptThreshold) {
+  acceptThreshold[0] = 4294967296ULL;
+  for (int d = 1; d <= kMaxSwapDelta; ++d) {
+    acceptThreshold[d] = static_cast<uint64_t>(
+        std::min(exp(-d / temperature), 1.0f) * 4294967296.0);
+  }
+}
+
+// the orders we actually run get their own specialized loop
+int Sudoku::runSweep(const uint64_t* acceptThreshold, int steps,
+    uint64_t conflictThreshold) {
+  switch (_order) {
+    case 3:  return sweep<3>(acceptThreshold, steps, conflictThreshold);
+    case 4:  return sweep<4>(acceptThreshold, steps, conflictThreshold);
+    case 5:  return sweep<5>(acceptThreshold, steps, conflictThreshold);
+    default: return sweep<0>(acceptThreshold, steps, conflictThreshold);
+  }
+}
+
+// Collects every conflicting free cell that a move can touch.
+void Sudoku::rebuildConflicts() {
+  _conflictCells.resize(_n*_n);
+  _inConflicts.assign(_n*_n, 0);
+  _nConflicts = 0;
+  _conflictAge = 0;
+  for (size_t m = 0; m < _movableSquares.size(); ++m) {
+    int sq = _movableSquares[m];
+    for (int k = _squareStart[sq]; k < _squareStart[sq+1]; ++k) {
+      int c = _freeCells[k];
+      if (isConflicting(&_board[0], &_rowCount[0], &_colCount[0], _n, c)) {
+        _inConflicts[c] = 1;
+        _conflictCells[_nConflicts++] = c;
+      }
+    }
+  }
+}
+
+// *************************
+// * Rejection-free search *
+// *************************
+//
+// In the cold phase nearly every proposal is rejected. The n-fold way skips
+// them: with every legal move m weighted by the chance that a proposal picks
+// it and accepts it, w(m) = q(m) * min(1, exp(-delta(m)/T)), the next
+// accepted move is m with probability w(m)/W, and it comes after a
+// geometric number of proposals with success probability W = sum of w(m).
+// q(m) = 1 / (movable squares * pairs in its square), as in sweep().
+//
+// The deltas of the k(k-1)/2 moves of each square are kept with a
+// histogram per square, so a square's weight only needs the 2*kMaxSwapDelta
+// + 1 acceptance probabilities, and the squares' weights sit in a Fenwick
+// tree. A move of values a and b only changes how many a's and b's its two
+// rows and two columns have, so afterwards only the moves that involve the
+// cells holding a or b, in the squares of the same band or stack, need
+// their deltas recomputed: about 2k per square instead of k(k-1)/2.
+
+namespace {
+
+const int kDeltaBins = 2 * Sudoku::kMaxSwapDelta + 1;
+
+void fenwickAdd(double* tree, int size, int i, double change) {
+  for (++i; i <= size; i += i & -i) tree[i] += change;
+}
+
+// Index of the leaf where the prefix sums reach 'target'.
+int fenwickFind(const double* tree, int size, double target) {
+  int pos = 0, step = 1;
+  while (step * 2 <= size) step *= 2;
+  for (; step > 0; step /= 2) {
+    if (pos + step <= size && tree[pos + step] < target) {
+      pos += step;
+      target -= tree[pos];
+    }
+  }
+  return pos;
+}
+
+}  // namespace
+
+// Sizes the move tables and computes every delta. Returns false if there
+// are too many moves for it to pay off (big boards).
+bool Sudoku::buildRejectionFree() {
+  const long long kMaxMoves = 1 << 24;
+  long long moves = 0;
+  _rfMoveStart.assign(_n+1, 0);
+  for (int sq = 0; sq < _n; ++sq) {
+    long long k = _squareStart[sq+1] - _squareStart[sq];
+    _rfMoveStart[sq] = moves;
+    moves += k * (k-1) / 2;
+    if (moves > kMaxMoves) return false;
+  }
+  _rfMoveStart[_n] = moves;
+  _rfDelta.resize(moves);
+  _rfHist.assign(_n * kDeltaBins, 0);
+  _rfWeight.assign(_n, 0);
+  _rfTree.assign(_n+1, 0);
+  for (int sq = 0; sq < _n; ++sq) refreshSquareMoves(sq);
+  return true;
+}
+
+// Recomputes the deltas and the histogram of the moves of a square.
+void Sudoku::refreshSquareMoves(int sq) {
+  const int begin = _squareStart[sq], k = _squareStart[sq+1] - begin;
+  int8_t* delta = &_rfDelta[0] + _rfMoveStart[sq];
+  int* hist = &_rfHist[sq * kDeltaBins];
+  std::fill(hist, hist + kDeltaBins, 0);
+  for (int x = 0; x < k; ++x) {
+    const int a = _freeCells[begin + x];
+    for (int y = x+1; y < k; ++y) {
+      const int b = _freeCells[begin + y];
+      int d = deltaFromCounts(&_board[0], &_rowCount[0], &_colCount[0], _n,
+          a / _n, a % _n, b / _n, b % _n);
+      *delta++ = d;
+      ++hist[d + kMaxSwapDelta];
+    }
+  }
+}
+
+// Recomputes the deltas of the moves of a square that involve the cells
+// holding values a or b.
+void Sudoku::refreshValueMoves(int sq, int a, int b) {
+  const int begin = _squareStart[sq], k = _squareStart[sq+1] - begin;
+  int8_t* delta = &_rfDelta[0] + _rfMoveStart[sq];
+  int* hist = &_rfHist[sq * kDeltaBins];
+  int held[2], nHeld = 0;
+  for (int x = 0; x < k && nHeld < 2; ++x) {
+    int v = _board[_freeCells[begin + x]];
+    if (v == a || v == b) held[nHeld++] = x;
+  }
+  for (int h = 0; h < nHeld; ++h) {
+    const int x = held[h], cx = _freeCells[begin + x];
+    for (int y = 0; y < k; ++y) {
+      if (y == x || (h == 1 && y == held[0])) continue;  // that one's done
+      const int lo = std::min(x, y), hi = std::max(x, y);
+      const int cy = _freeCells[begin + y];
+      int8_t* old = delta + lo*k - lo*(lo+1)/2 + (hi - lo - 1);
+      int d = deltaFromCounts(&_board[0], &_rowCount[0], &_colCount[0], _n,
+          cx / _n, cx % _n, cy / _n, cy % _n);
+      --hist[*old + kMaxSwapDelta];
+      ++hist[d + kMaxSwapDelta];
+      *old = d;
+    }
+  }
+}
+
+// Weight of a square from its histogram.
+double Sudoku::squareWeight(int sq) const {
+  const int k = _squareStart[sq+1] - _squareStart[sq];
+  const int* hist = &_rfHist[sq * kDeltaBins];
+  double w = 0;
+  if (k < 2) return 0;
+  for (int d = 0; d < kDeltaBins; ++d) w += hist[d] * _rfAccept[d];
+  return w / (_movableSquares.size() * (k * (k-1) / 2.0));
+}
+
+// New temperature: new acceptance probabilities and a new tree (which also
+// clears the rounding errors of the incremental updates).
+void Sudoku::setRejectionFreeTemp(float temperature) {
+  for (int d = -kMaxSwapDelta; d <= kMaxSwapDelta; ++d) {
+    _rfAccept[d + kMaxSwapDelta] = d <= 0 ? 1 : exp(-d / temperature);
+  }
+  std::fill(_rfTree.begin(), _rfTree.end(), 0);
+  for (int sq = 0; sq < _n; ++sq) {
+    _rfWeight[sq] = squareWeight(sq);
+    _rfTree[sq+1] += _rfWeight[sq];
+    int parent = (sq+1) + ((sq+1) & -(sq+1));
+    if (parent <= _n) _rfTree[parent] += _rfTree[sq+1];
+  }
+}
+
+// Runs 'steps' proposals' worth of the chain at the temperature of the last
+// setRejectionFreeTemp(), making only the accepted moves. Stops early at
+// cost 0. Returns the proposals it stands for.
+int Sudoku::rejectionFreeSweep(int steps) {
+  const double kTwoTo32 = 4294967296.0;
+  int proposals = 0, accepted = 0;
+#ifdef SUDOKU_TELEMETRY
+  int uphillAccepted = 0;
+#endif
+  double total = 0;
+  for (int sq = 0; sq < _n; ++sq) total += _rfWeight[sq];
+
+  while (_cost > 0 && total > 0) {
+    // proposals until the next accepted one: geometric with parameter total
+    double u = (_rng.next() + 1.0) / kTwoTo32;  // (0, 1]
+    double skip = total >= 1 ? 1 : 1 + floor(log(u) / log1p(-total));
+    if (proposals + skip > steps) {
+      proposals = steps;
+      break;
+    }
+    proposals += static_cast<int>(skip);
+
+    // the move: a square by weight, a delta by weight, a move with it
+    double target = _rng.next() / kTwoTo32 * total;
+    int sq = std::min(fenwickFind(&_rfTree[0], _n, target), _n-1);
+    while (_rfWeight[sq] <= 0) sq = (sq + 1) % _n;  // rounding, at the ends
+    const int* hist = &_rfHist[sq * kDeltaBins];
+    double binTarget = _rng.next() / kTwoTo32, binTotal = 0;
+    int bin = 0;
+    for (int d = 0; d < kDeltaBins; ++d) binTotal += hist[d] * _rfAccept[d];
+    binTarget *= binTotal;
+    for (bin = 0; bin < kDeltaBins - 1; ++bin) {
+      double w = hist[bin] * _rfAccept[bin];
+      if (hist[bin] > 0 && binTarget < w) break;
+      binTarget -= w;
+    }
+    while (hist[bin] == 0) --bin;  // rounding, at the last bin
+    int pick = _rng.below(hist[bin]);
+    const int begin = _squareStart[sq], k = _squareStart[sq+1] - begin;
+    const int8_t* delta = &_rfDelta[0] + _rfMoveStart[sq];
+    int a = -1, b = -1;
+    for (int x = 0; x < k && a < 0; ++x) {
+      for (int y = x+1; y < k; ++y, ++delta) {
+        if (*delta == bin - kMaxSwapDelta && pick-- == 0) {
+          a = _freeCells[begin + x];
+          b = _freeCells[begin + y];
+          break;
         }
       }
     }
-    temperature *= alpha;
+
+    swapAndCount(&_board[0], &_rowCount[0], &_colCount[0], _n,
+        a / _n, a % _n, b / _n, b % _n);
+    _cost += bin - kMaxSwapDelta;
+    noteChanged(a, &_changedCells[0], &_cellChanged[0], &_nChanged);
+    noteChanged(b, &_changedCells[0], &_cellChanged[0], &_nChanged);
+    ++accepted;
+#ifdef SUDOKU_TELEMETRY
+    if (bin > kMaxSwapDelta) ++uphillAccepted;
+#endif
+
+    // the squares of the same band and stack
+    const int band = sq / _order, stack = sq % _order;
+    const int va = _board[a], vb = _board[b];
+    for (int t = 0; t < 2 * _order; ++t) {
+      int other = t < _order ? band * _order + t
+        : (t - _order) * _order + stack;
+      if (t >= _order && other == sq) continue;  // already done
+      refreshValueMoves(other, va, vb);
+      double w = squareWeight(other);
+      fenwickAdd(&_rfTree[0], _n, other, w - _rfWeight[other]);
+      total += w - _rfWeight[other];
+      _rfWeight[other] = w;
+    }
   }
+  // every move's weight underflowed: the rest of the stage is rejections
+  if (_cost > 0 && total <= 0) proposals = steps;
+  _stageStats.proposals = proposals;
+  _stageStats.accepted = accepted;
+#ifdef SUDOKU_TELEMETRY
+  _stageStats.uphillAccepted = uphillAccepted;
+#endif
+  return proposals;
+}
 
-  end = clock();
-  *seconds = static_cast<double>(end-begin)/CLOCKS_PER_SEC;
-  *finalSolution = curSolution;
+// Makes up to 'steps' proposals, accepting uphill moves according to
+// acceptThreshold. Stops early if it reaches cost 0. Returns how many
+// proposals it made.
+template <int kOrder>
+int Sudoku::sweep(const uint64_t* acceptThreshold, int steps,
+    uint64_t conflictThreshold) {
+  const int order = kOrder > 0 ? kOrder : _order;
+  const int n = order * order;
+  TCell* board = &_board[0];
+  TCount* rowCount = &_rowCount[0];
+  TCount* colCount = &_colCount[0];
+  int* changed = &_changedCells[0];
+  uint8_t* cellChanged = &_cellChanged[0];
+  int nChanged = _nChanged;
+  const int* freeCells = &_freeCells[0];
+  const int* squareStart = &_squareStart[0];
+  const int* movable = &_movableSquares[0];
+  const int nMovable = _movableSquares.size();
+  // cell selection variables
+  int s, k, a, b;       // selected square, its free cells count and picks
+  int p1, q1, p2, q2;   // selected cells (p1,q1) and (p2,q2)
+  // simulated annealing variables
+  int curSolution = _cost;
+  int deltaS;
+  int stepI;
+  RandomEngine rng = _rng;  // local copy, so it can live in registers
+  int accepted = 0;         // (the adaptive schedule needs it)
+  // conflict-directed moves (unused when conflictThreshold is 0)
+  int* conflicts = conflictThreshold != 0 ? &_conflictCells[0] : NULL;
+  uint8_t* inConflicts = conflictThreshold != 0 ? &_inConflicts[0] : NULL;
+  const uint8_t* conflictable = &_conflictable[0];
+  int nConflicts = conflictThreshold != 0 ? _nConflicts : 0;
+#ifdef SUDOKU_TELEMETRY
+  int uphillAccepted = 0;
+#endif
 
-  return (curSolution == 0);
+  for (stepI = 0; stepI < steps && curSolution > 0; ++stepI) {
+    a = -1;
+    if (conflictThreshold != 0 && rng.next() < conflictThreshold) {
+      // a conflicting cell, dropping the ones that no longer are
+      if (nConflicts == 0 && _conflictAge + stepI >= n*n) {
+        rebuildConflicts();
+        _conflictAge = -stepI;
+        nConflicts = _nConflicts;
+      }
+      while (nConflicts > 0) {
+        int t = rng.below(nConflicts);
+        int c = conflicts[t];
+        if (isConflicting(board, rowCount, colCount, n, c)) {
+          a = c;
+          break;
+        }
+        conflicts[t] = conflicts[--nConflicts];
+        inConflicts[c] = 0;
+      }
+    }
+    if (a >= 0) {
+      // and another free cell of its square
+      p1 = a / n; q1 = a % n;
+      s = (p1 / order) * order + q1 / order;
+      k = squareStart[s+1] - squareStart[s];
+      b = freeCells[squareStart[s] + rng.below(k-1)];
+      if (b == a) b = freeCells[squareStart[s] + k-1];
+    } else {
+      // selection of two distinct non-fixed cells in the same square,
+      // straight from the free cells index (no retries)
+      s = movable[rng.below(nMovable)];
+      k = squareStart[s+1] - squareStart[s];
+      a = rng.below(k);
+      b = rng.below(k-1);
+      if (b >= a) ++b;
+      a = freeCells[squareStart[s] + a];
+      b = freeCells[squareStart[s] + b];
+      p1 = a / n; q1 = a % n;
+    }
+    p2 = b / n; q2 = b % n;
+
+    // evaluate the swap before doing it, so rejected moves cost nothing
+    deltaS = deltaFromCounts(board, rowCount, colCount, n, p1, q1, p2, q2);
+
+    if (deltaS <= 0 || rng.next() < acceptThreshold[deltaS]) {
+      swapAndCount(board, rowCount, colCount, n, p1, q1, p2, q2);
+      curSolution += deltaS;
+      noteChanged(a, changed, cellChanged, &nChanged);
+      noteChanged(b, changed, cellChanged, &nChanged);
+      ++accepted;
+#ifdef SUDOKU_TELEMETRY
+      if (deltaS > 0) ++uphillAccepted;
+#endif
+      if (conflictThreshold != 0) {
+        // the two cells, and whoever they now collide with: a's new value
+        // came into row p1 and column q1, b's into row p2 and column q2
+        const int va = board[a], vb = board[b];
+        noteConflict(board, rowCount, colCount, n, a, conflicts,
+            inConflicts, &nConflicts);
+        noteConflict(board, rowCount, colCount, n, b, conflicts,
+            inConflicts, &nConflicts);
+        if (p1 != p2 && rowCount[p1*(n+1) + va] == 2) {
+          notePartner(board, n, p1*n, 1, va, a, conflictable, conflicts,
+              inConflicts, &nConflicts);
+        }
+        if (p1 != p2 && rowCount[p2*(n+1) + vb] == 2) {
+          notePartner(board, n, p2*n, 1, vb, b, conflictable, conflicts,
+              inConflicts, &nConflicts);
+        }
+        if (q1 != q2 && colCount[q1*(n+1) + va] == 2) {
+          notePartner(board, n, q1, n, va, a, conflictable, conflicts,
+              inConflicts, &nConflicts);
+        }
+        if (q1 != q2 && colCount[q2*(n+1) + vb] == 2) {
+          notePartner(board, n, q2, n, vb, b, conflictable, conflicts,
+              inConflicts, &nConflicts);
+        }
+      }
+    }
+  }
+  if (conflictThreshold != 0) {
+    _nConflicts = nConflicts;
+    _conflictAge += stepI;
+  }
+  _nChanged = nChanged;
+  _stageStats.proposals = stepI;
+  _stageStats.accepted = accepted;
+#ifdef SUDOKU_TELEMETRY
+  _stageStats.uphillAccepted = uphillAccepted;
+#endif
+  _rng = rng;
+  _cost = curSolution;
+  return stepI;
 }
 
 // print some information to stdout
@@ -282,8 +1756,8 @@ void Sudoku::dump() {
     for (int j = 0; j < _n; ++j) {
       if (j % _order == 0)
         printf("|");
-      if (_board[i][j] > 0)
-        printf("% 3d ", _board[i][j]);
+      if (cell(i, j) > 0)
+        printf("% 3d ", cell(i, j));
       else
         printf(" __ ");
     }
@@ -304,7 +1778,7 @@ void Sudoku::dumpBoardToFile(const char* filename) {
     output << _order << std::endl;
     for (int i = 0; i < _n; ++i) {
       for (int j = 0; j < _n; ++j) {
-        output << _board[i][j] << " ";
+        output << (cell(i, j) > 0 ? cell(i, j) : -1) << " ";
       }
       output << std::endl;
     }
@@ -312,37 +1786,42 @@ void Sudoku::dumpBoardToFile(const char* filename) {
 }
 
 // Evaluates the cost of the current configuration.
-// How? Returns the SUM of the REPEATED values in each row AND each column.
+// How? Returns the SUM of the REPEATED values in each row AND each column
+// (squares never repeat values during the search), or -1 if some cell is
+// not filled yet.
 int Sudoku::evaluateCurrentSolution() {
-  //                / true, if 'w' was already used in the current analysis
-  // usedNumbers[w]|
-  //                \ false otherwise.
-  std::vector<bool> usedNumbers;
-  int cost = 0;
+  BoardConflicts conflicts;
+  if (!countConflicts(&_board[0], _order, &_unitMasks[0], &conflicts)) {
+    return -1;
+  }
+  return conflicts.rows + conflicts.cols;
+}
 
-  // analyzes rows
-  for (int i = 0; i < _n; ++i) {
-    usedNumbers = std::vector<bool>(_n+1, false);
-    for (int j = 0; j < _n; ++j) {
-      // if board is not properly filled, exit
-      if (_board[i][j] < 1 || _board[i][j] > _n) return -1;
-      if (usedNumbers[_board[i][j]]) {
-        ++cost;
-      } else {
-        usedNumbers[_board[i][j]] = true;
-      }
-    }
+// Checks the current board from scratch, without trusting the search state:
+// every cell filled, the givens untouched and no value repeated in any row,
+// column or square.
+bool Sudoku::verifySolution() {
+  BoardConflicts conflicts;
+  if (_order < 1) return false;
+  for (int k = 0; k < _n*_n; ++k) {
+    if (_givens[k] != 0 && _board[k] != _givens[k]) return false;
   }
+  return countConflicts(&_board[0], _order, &_unitMasks[0], &conflicts)
+    && conflicts.rows == 0 && conflicts.cols == 0 && conflicts.squares == 0;
+}
 
-  // analyzes columns
-  for (int j = 0; j < _n; ++j) {
-    usedNumbers = std::vector<bool>(_n+1, false);
-    for (int i = 0; i < _n; ++i) {
-      if (usedNumbers[_board[i][j]]) {
-        ++cost;
-      } else {
-        usedNumbers[_board[i][j]] = true;
-      }
+// Counts, for every row and column, how many times each value shows up.
+// The cost is then the sum of the surplus occurrences (count - 1) of each
+// value in each line, which is what evaluateCurrentSolution() computes.
+int Sudoku::buildOccurrenceTables() {
+  int cost = 0;
+  _rowCount.assign(_n*(_n+1), 0);
+  _colCount.assign(_n*(_n+1), 0);
+  for (int i = 0; i < _n; ++i) {
+    for (int j = 0; j < _n; ++j) {
+      if (cell(i, j) < 1 || cell(i, j) > _n) return -1;
+      if (_rowCount[i*(_n+1) + cell(i, j)]++ > 0) ++cost;
+      if (_colCount[j*(_n+1) + cell(i, j)]++ > 0) ++cost;
     }
   }
   return cost;
@@ -0,0 +1,129 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <sudoku_c.h>
+#include <sudoku.h>
+#include <atomic>
+#include <new>
+
+struct sudoku_solver {
+  Sudoku              sudoku;
+  std::atomic<bool>   stop;
+  bool                loaded;   // the last load succeeded (1 or -1)
+};
+
+sudoku_solver* sudoku_create(void) {
+  sudoku_solver* solver = new (std::nothrow) sudoku_solver;
+  if (solver == NULL) return NULL;
+  solver->stop.store(false);
+  solver->loaded = false;
+  solver->sudoku.setStopFlag(&solver->stop);
+  return solver;
+}
+
+void sudoku_destroy(sudoku_solver* solver) {
+  delete solver;
+}
+
+void sudoku_default_params(sudoku_params* params) {
+  SAParams defaults;
+  params->initial_temp = 0;
+  params->alpha = defaults.alpha;
+  params->stages_length = 0;
+  params->random_seed = defaults.randomSeed;
+  params->max_seconds = 0;
+  params->max_proposals = 0;
+  params->stall_stages = 0;
+  params->restart = 0;
+}
+
+int sudoku_load_file(sudoku_solver* solver, const char* filename) {
+  const int status = filename == NULL ? 0
+    : solver->sudoku.loadInstance(filename, true);
+  solver->loaded = status != 0;
+  return status;
+}
+
+int sudoku_load_cells(sudoku_solver* solver, int order, const int* cells) {
+  const int status = cells == NULL ? 0
+    : solver->sudoku.loadInstance(order, cells, true);
+  solver->loaded = status != 0;
+  return status;
+}
+
+int sudoku_presolve(sudoku_solver* solver) {
+  if (!solver->loaded) return -1;
+  return solver->sudoku.presolve();
+}
+
+int sudoku_solve(sudoku_solver* solver, const sudoku_params* params,
+    sudoku_result* result) {
+  const int order = solver->sudoku.order();
+  SAParams sa;
+  SAResult out;
+  if (!solver->loaded || order < 1) return 0;
+  sa.initialTemp = params->initial_temp > 0 ? params->initial_temp
+    : order * 100;
+  sa.alpha = params->alpha;
+  sa.stagesLength = params->stages_length > 0 ? params->stages_length
+    : order * order;
+  sa.randomSeed = params->random_seed;
+  sa.maxSeconds = params->max_seconds;
+  sa.maxProposals = params->max_proposals;
+  sa.stallStages = params->stall_stages;
+  sa.restart = params->restart != 0;
+  solver->stop.store(false);
+  solver->sudoku.solve(sa, &out);
+  if (result != NULL) {
+    result->status = out.status;
+    result->initial_cost = out.initialSolution;
+    result->final_cost = out.finalSolution;
+    result->seconds = out.seconds;
+    result->proposals = out.proposals;
+  }
+  return out.status == kSolved;
+}
+
+void sudoku_reset(sudoku_solver* solver) {
+  if (!solver->loaded) return;
+  solver->sudoku.reset();
+}
+
+void sudoku_stop(sudoku_solver* solver) {
+  solver->stop.store(true);
+}
+
+int sudoku_order(const sudoku_solver* solver) {
+  return solver->sudoku.order();
+}
+
+void sudoku_get_cells(const sudoku_solver* solver, int* cells) {
+  const int n = solver->sudoku.order() * solver->sudoku.order();
+  if (!solver->loaded || solver->sudoku.order() < 1) return;
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) cells[i*n + j] = solver->sudoku.cell(i, j);
+  }
+}
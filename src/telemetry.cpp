@@ -0,0 +1,109 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <telemetry.h>
+#include <cstring>
+
+TraceWriter::TraceWriter() : _file(NULL), _csv(false), _every(1),
+  _closing(false) {}
+
+TraceWriter::~TraceWriter() {
+  close();
+}
+
+bool TraceWriter::open(const char* filename, int every) {
+  const size_t length = strlen(filename);
+  close();
+  _csv = length >= 4 && strcmp(filename + length - 4, ".csv") == 0;
+  _file = fopen(filename, _csv ? "w" : "wb");
+  if (_file == NULL) return false;
+  if (_csv) {
+    fprintf(_file, "stage,temperature,cost,best_cost,proposals,accepted,"
+        "uphill_accepted,rejected,seconds\n");
+  } else {
+    const uint32_t recordSize = sizeof(TraceRecord);
+    fwrite("SATRACE2", 1, 8, _file);
+    fwrite(&recordSize, sizeof(recordSize), 1, _file);
+  }
+  _every = every > 0 ? every : 1;
+  _filling.reserve(kBatchRecords);
+  _closing = false;
+  _thread = std::thread(&TraceWriter::writerLoop, this);
+  return true;
+}
+
+// Moves the filled buffer to the writer thread, keeping its capacity.
+void TraceWriter::handOver() {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _pending.insert(_pending.end(), _filling.begin(), _filling.end());
+  }
+  _filling.clear();
+  _wake.notify_one();
+}
+
+void TraceWriter::close() {
+  if (_file == NULL) return;
+  handOver();
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _closing = true;
+  }
+  _wake.notify_one();
+  _thread.join();
+  fclose(_file);
+  _file = NULL;
+}
+
+// Takes the pending records (they only change hands under the lock) and
+// formats and writes them.
+void TraceWriter::writerLoop() {
+  std::vector<TraceRecord> writing;
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    while (_pending.empty() && !_closing) _wake.wait(lock);
+    if (_pending.empty()) break;
+    writing.swap(_pending);
+    lock.unlock();
+
+    if (_csv) {
+      for (size_t k = 0; k < writing.size(); ++k) {
+        const TraceRecord& r = writing[k];
+        fprintf(_file, "%d,%g,%d,%d,%lld,%lld,%lld,%lld,%.6f\n", r.stage,
+            r.temperature, r.cost, r.bestCost,
+            static_cast<long long>(r.proposals),
+            static_cast<long long>(r.accepted),
+            static_cast<long long>(r.uphillAccepted),
+            static_cast<long long>(r.rejected), r.seconds);
+      }
+    } else {
+      fwrite(&writing[0], sizeof(TraceRecord), writing.size(), _file);
+    }
+    writing.clear();
+
+    lock.lock();
+  }
+}
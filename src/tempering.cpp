@@ -0,0 +1,123 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <tempering.h>
+#include <thread_pool.h>
+#include <rng.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+bool solveTempering(Sudoku* instance, int replicas, float minTemp,
+    float maxTemp, int interval, int threads, unsigned int randomSeed,
+    double maxSeconds, long long maxProposals, TemperingResult* result) {
+  std::vector<Sudoku> boards(replicas, *instance);
+  std::vector<float> ladder(replicas);
+  // at[t]: replica currently at ladder position t. Exchanging two boards is
+  // done by exchanging their positions, so no board is ever copied.
+  std::vector<int> at(replicas);
+  // made[k]: proposals replica k made in the last round (it stops at cost 0)
+  std::vector<int> made(replicas);
+  RandomEngine rng(randomSeed ^ 0x5851f42d4c957f2dULL);
+  int solved = -1;
+  bool outOfBudget = false;
+
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+  result->initialSolution = -1;
+  for (int k = 0; k < replicas; ++k) {
+    ladder[k] = replicas == 1 ? minTemp
+      : minTemp * pow(maxTemp / minTemp, static_cast<double>(k) / (replicas-1));
+    at[k] = k;
+    int cost = boards[k].startSearch(randomSeed + k);
+    if (result->initialSolution < 0 || cost < result->initialSolution) {
+      result->initialSolution = cost;
+    }
+    if (cost == 0) solved = k;
+  }
+  result->rounds = result->exchanges = result->accepted = 0;
+  result->proposals = 0;
+
+  if (threads <= 0) threads = std::thread::hardware_concurrency();
+  ThreadPool pool(std::max(1, std::min(threads, replicas)));
+  while (solved < 0 && !outOfBudget && instance->canMove()) {
+    // sweeps: every replica at its own temperature, in parallel
+    for (int t = 0; t < replicas; ++t) {
+      Sudoku* board = &boards[at[t]];
+      int* count = &made[at[t]];
+      float temperature = ladder[t];
+      pool.submit([board, count, temperature, interval]() {
+        *count = board->metropolis(temperature, interval);
+      });
+    }
+    pool.wait();
+    ++result->rounds;
+    for (int k = 0; k < replicas; ++k) result->proposals += made[k];
+
+    // exchanges between neighbouring temperatures
+    for (int t = result->rounds % 2; t + 1 < replicas; t += 2) {
+      int ei = boards[at[t]].cost();
+      int ej = boards[at[t+1]].cost();
+      double x = (1.0 / ladder[t] - 1.0 / ladder[t+1]) * (ei - ej);
+      ++result->exchanges;
+      if (x >= 0 || rng.next() < exp(x) * 4294967296.0) {
+        std::swap(at[t], at[t+1]);
+        ++result->accepted;
+      }
+    }
+    for (int t = 0; t < replicas; ++t) {
+      if (boards[at[t]].cost() == 0) {
+        solved = t;
+        break;
+      }
+    }
+    if (maxProposals > 0 && result->proposals >= maxProposals) {
+      outOfBudget = true;
+    }
+    if (maxSeconds > 0) {
+      std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+      outOfBudget = outOfBudget || elapsed.count() >= maxSeconds;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - begin;
+
+  if (solved < 0) {  // out of budget: keep the lowest cost replica
+    solved = 0;
+    for (int t = 1; t < replicas; ++t) {
+      if (boards[at[t]].cost() < boards[at[solved]].cost()) solved = t;
+    }
+  }
+  *instance = boards[at[solved]];
+  result->replica = at[solved];
+  result->temperature = ladder[solved];
+  result->finalSolution = instance->cost();
+  result->seconds = elapsed.count();
+  return result->finalSolution == 0;
+}
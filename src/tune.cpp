@@ -0,0 +1,367 @@
+/* Copyright 2013 Ricardo Godoy de Oliveira
+ *
+ * ----------------------------------------------------------------------------
+ * This file is part of Sudoku SA Solver.
+ *
+ * Sudoku SA Solver is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Sudoku SA Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * <http://www.gnu.org/licenses/>
+ * ----------------------------------------------------------------------------
+ * This project is part of an assignment for the course of INF05010 (Combina-
+ * torial Optimization) at the Informatics Institute of the Federal University
+ * of Rio Grando do Sul (UFRGS). It's aim is to solve instances of Sudoku using
+ * the meta-heuristic known as Simulated Annealing.
+ * Along with this program, there should be a technical report containing the
+ * results of the experimentation against some instances of the game, as well
+ * as information about the meta-heuristic and algorithms used.
+ * ----------------------------------------------------------------------------
+ */
+
+// Parameter tuning: searches initial temperature, alpha and stage length for
+// each class of instances of a corpus (order x fill percentage, from names
+// like etc/4_45) by successive halving, in-process and on all cores:
+//  - a set of configurations is drawn at random (plus the defaults of
+//    sudoku and the adaptive schedule);
+//  - every surviving configuration gets some runs on the instances of the
+//    class, the best 1/eta of them survive and get eta times as many runs in
+//    the next round, until one is left.
+// Configurations are ranked by success rate, then by mean time with failed
+// runs counted as the time limit, then by mean final cost. Temperatures and
+// stage lengths scale with the order (order * k and order^2 * k), so a
+// configuration means the same for every class.
+
+#include <sudoku.h>
+#include <thread_pool.h>
+#include <instance_io.h>
+#include <rng.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// One point of the search space.
+struct Config {
+  bool    adaptive;       // adaptive schedule (the fields below are unused)
+  float   tempFactor;     // initial temperature = tempFactor * order
+  float   alpha;
+  float   lengthFactor;   // stage length = lengthFactor * order^2
+};
+
+// One annealing run.
+struct Run {
+  bool    solved;
+  int     finalSolution;
+  double  seconds;
+};
+
+// Performance of a configuration on a class, over its runs so far.
+struct Score {
+  int     runs;
+  double  successRate;
+  double  parSeconds;     // mean time, failed runs counting as the limit
+  double  meanFinalCost;
+};
+
+// Instances of the same order and fill percentage, and how each
+// configuration did on them.
+struct InstanceClass {
+  std::string                     name;
+  int                             order;
+  std::vector<Sudoku>             instances;
+  std::vector<std::vector<Run> >  runs;     // per configuration
+  std::vector<int>                alive;    // configurations still racing
+};
+
+// Uniform in [0, 1).
+double uniform(Xoshiro256* rng) {
+  return rng->next() / 4294967296.0;
+}
+
+// The defaults of sudoku, the adaptive schedule and 'count' - 2 random
+// configurations: temperature log-uniform in [0.01, 100] * order, 1 - alpha
+// log-uniform in [0.001, 0.2], stage length log-uniform in [1/4, 64] * n.
+std::vector<Config> drawConfigs(int count, unsigned int seed) {
+  std::vector<Config> configs;
+  Xoshiro256 rng(seed);
+  Config c;
+  c.adaptive = false;
+  c.tempFactor = 100;
+  c.alpha = 0.9;
+  c.lengthFactor = 1;
+  configs.push_back(c);
+  c.adaptive = true;
+  configs.push_back(c);
+  c.adaptive = false;
+  while (static_cast<int>(configs.size()) < count) {
+    c.tempFactor = pow(10, -2 + 4*uniform(&rng));
+    c.alpha = 1 - pow(10, -3 + 2.3*uniform(&rng));
+    c.lengthFactor = pow(2, -2 + 8*uniform(&rng));
+    configs.push_back(c);
+  }
+  configs.resize(count);
+  return configs;
+}
+
+SAParams paramsFor(const Config& c, int order, const SAParams& base) {
+  SAParams params = base;
+  params.adaptive = c.adaptive;
+  if (c.adaptive) {
+    params.initialTemp = 0;
+    params.stagesLength = 0;
+  } else {
+    params.initialTemp = c.tempFactor * order;
+    params.alpha = c.alpha;
+    params.stagesLength = std::max(1,
+        static_cast<int>(c.lengthFactor * order * order));
+  }
+  return params;
+}
+
+Score score(const std::vector<Run>& runs, double timeLimit) {
+  Score s;
+  int solved = 0;
+  double seconds = 0, costs = 0;
+  for (size_t k = 0; k < runs.size(); ++k) {
+    if (runs[k].solved) ++solved;
+    seconds += runs[k].solved ? runs[k].seconds : timeLimit;
+    costs += runs[k].finalSolution;
+  }
+  s.runs = runs.size();
+  s.successRate = s.runs > 0 ? static_cast<double>(solved) / s.runs : 0;
+  s.parSeconds = s.runs > 0 ? seconds / s.runs : 0;
+  s.meanFinalCost = s.runs > 0 ? costs / s.runs : 0;
+  return s;
+}
+
+bool better(const Score& a, const Score& b) {
+  if (a.successRate != b.successRate) return a.successRate > b.successRate;
+  if (a.parSeconds != b.parSeconds) return a.parSeconds < b.parSeconds;
+  return a.meanFinalCost < b.meanFinalCost;
+}
+
+void describe(const Config& c, int order, char* out, size_t size) {
+  if (c.adaptive) {
+    snprintf(out, size, "-adaptive");
+  } else {
+    snprintf(out, size, "-it %g -alpha %.4f -sl %d", c.tempFactor * order,
+        c.alpha, std::max(1, static_cast<int>(c.lengthFactor*order*order)));
+  }
+}
+
+void usage() {
+  printf("\nUsage: tune [options] [instance files...]\n");
+  printf("Finds the best annealing settings for each instance class (order x fill%%)\n");  // NOLINT
+  printf("of a corpus (default: etc/<order>_<fill>) by successive halving.\n\n");  // NOLINT
+  printf("Options:\n");
+  printf("  -dir <D>      \t: Corpus directory, when no files are given. Default: etc\n");  // NOLINT
+  printf("  -configs <N>  \t: Configurations to start with. Default: 27\n");
+  printf("  -runs <N>     \t: Runs per configuration in the first round. Default: 2\n");  // NOLINT
+  printf("  -eta <N>      \t: Keep the best 1/N each round, with N times the runs. Default: 3\n");  // NOLINT
+  printf("  -tl <N>       \t: Time limit per run, in seconds. Default: 1\n");
+  printf("  -stall <N>    \t: Reheat after N stages without improving. Default: 0 (never)\n");  // NOLINT
+  printf("  -rs <N>       \t: Seed for drawing configurations. Default: 1\n");
+  printf("  -threads <N>  \t: Runs in parallel (0: one per core). Default: 0\n");  // NOLINT
+  printf("  -nopresolve   \t: Skip presolve\n");
+  printf("  -csv <F>      \t: Write the best configuration of each class as CSV\n");  // NOLINT
+  printf("\n");
+}
+
+}  // namespace
+
+// Exit values: 0 ok, 1 output error, 4 invalid argument, 5 invalid value,
+// 6 instance error.
+int main(int argc, char* argv[]) {
+  std::vector<std::string> files;
+  const char* dir = "etc";
+  const char* csvFilename = NULL;
+  int nConfigs = 27, firstRuns = 2, eta = 3, threads = 0;
+  unsigned int seed = 1;
+  bool presolve = true;
+  SAParams base;
+
+  base.maxSeconds = 1;
+  base.stallStages = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string str = argv[i];
+    bool hasValue = i+1 < argc;
+    if (str == "-h" || str == "-help") {
+      usage();
+      return 0;
+    } else if (str == "-nopresolve") {
+      presolve = false;
+    } else if (str[0] != '-') {
+      files.push_back(str);
+    } else if (!hasValue) {
+      printf("\nMissing value for \"%s\"\n", argv[i]);
+      return 5;
+    } else if (str == "-dir") {
+      dir = argv[++i];
+    } else if (str == "-configs") {
+      nConfigs = atoi(argv[++i]);
+    } else if (str == "-runs") {
+      firstRuns = atoi(argv[++i]);
+    } else if (str == "-eta") {
+      eta = atoi(argv[++i]);
+    } else if (str == "-tl") {
+      base.maxSeconds = atof(argv[++i]);
+    } else if (str == "-stall") {
+      base.stallStages = atoi(argv[++i]);
+    } else if (str == "-rs") {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else if (str == "-threads") {
+      threads = atoi(argv[++i]);
+    } else if (str == "-csv") {
+      csvFilename = argv[++i];
+    } else {
+      printf("\nUnknown argument #%d \"%s\"\n", i, argv[i]);
+      usage();
+      return 4;
+    }
+  }
+  if (files.empty()) files = corpusFiles(dir);
+  if (files.empty() || nConfigs < 1 || firstRuns < 1 || eta < 2
+      || base.maxSeconds <= 0 || threads < 0) {
+    printf("\nNothing to run (no instances, or invalid settings).\n");
+    return 5;
+  }
+
+  // group the instances by class
+  std::vector<InstanceClass> classes;
+  std::map<std::string, size_t> classIndex;
+  for (size_t f = 0; f < files.size(); ++f) {
+    int order, fill;
+    Sudoku s;
+    if (s.loadInstance(files[f].c_str(), true) != 1
+        || (presolve && s.presolve() < 0)) {
+      printf("\nError processing instance \"%s\".\n", files[f].c_str());
+      return 6;
+    }
+    char name[32];
+    if (parseCorpusName(files[f], &order, &fill)) {
+      snprintf(name, sizeof(name), "%d_%d", order, fill);
+    } else {
+      snprintf(name, sizeof(name), "%d_?", s.order());
+    }
+    if (classIndex.find(name) == classIndex.end()) {
+      classIndex[name] = classes.size();
+      classes.push_back(InstanceClass());
+      classes.back().name = name;
+      classes.back().order = s.order();
+    }
+    InstanceClass& c = classes[classIndex[name]];
+    if (c.order != s.order()) {
+      printf("\nInstance \"%s\" doesn't match the order of its class.\n",
+          files[f].c_str());
+      return 6;
+    }
+    c.instances.push_back(s);
+  }
+
+  std::vector<Config> configs = drawConfigs(nConfigs, seed);
+  for (size_t k = 0; k < classes.size(); ++k) {
+    classes[k].runs.resize(configs.size());
+    for (size_t c = 0; c < configs.size(); ++c) classes[k].alive.push_back(c);
+  }
+
+  // successive halving; all the runs of a round (every class) share the pool
+  ThreadPool pool(threads);
+  printf("%zu classes, %zu configurations, %d threads, %gs per run\n",
+      classes.size(), configs.size(), pool.size(), base.maxSeconds);
+  int runsPerConfig = firstRuns;
+  for (int round = 1; ; ++round) {
+    int racing = 0;
+    for (size_t k = 0; k < classes.size(); ++k) {
+      InstanceClass& ic = classes[k];
+      if (ic.alive.size() > 1 || round == 1) racing += ic.alive.size();
+    }
+    if (racing == 0) break;
+    printf("round %d: %d configurations x %d runs\n", round, racing,
+        runsPerConfig);
+    fflush(stdout);
+
+    for (size_t k = 0; k < classes.size(); ++k) {
+      InstanceClass& ic = classes[k];
+      if (ic.alive.size() <= 1 && round > 1) continue;
+      for (size_t a = 0; a < ic.alive.size(); ++a) {
+        int c = ic.alive[a];
+        // run r: instance r mod count, seed r + 1; earlier runs are kept
+        size_t done = ic.runs[c].size();
+        ic.runs[c].resize(runsPerConfig);
+        for (size_t r = done; r < ic.runs[c].size(); ++r) {
+          pool.submit([&, c, r]() {
+            Sudoku s = ic.instances[r % ic.instances.size()];
+            SAParams params = paramsFor(configs[c], ic.order, base);
+            SAResult result;
+            params.randomSeed = r + 1;
+            Run& run = ic.runs[c][r];
+            run.solved = s.solve(params, &result) && s.verifySolution();
+            run.finalSolution = result.finalSolution;
+            run.seconds = result.seconds;
+          });
+        }
+      }
+    }
+    pool.wait();
+
+    for (size_t k = 0; k < classes.size(); ++k) {
+      InstanceClass& ic = classes[k];
+      std::vector<std::pair<Score, int> > ranked;
+      for (size_t a = 0; a < ic.alive.size(); ++a) {
+        int c = ic.alive[a];
+        ranked.push_back(std::make_pair(score(ic.runs[c], base.maxSeconds), c));
+      }
+      // stable: on ties the configurations drawn first (the defaults) win
+      std::stable_sort(ranked.begin(), ranked.end(),
+          [](const std::pair<Score, int>& a, const std::pair<Score, int>& b) {
+            return better(a.first, b.first);
+          });
+      size_t keep = std::max<size_t>(1, ranked.size() / eta);
+      ic.alive.clear();
+      for (size_t a = 0; a < keep; ++a) ic.alive.push_back(ranked[a].second);
+    }
+    runsPerConfig *= eta;
+  }
+
+  FILE* csv = NULL;
+  if (csvFilename != NULL) {
+    csv = fopen(csvFilename, "w");
+    if (csv == NULL) {
+      printf("\nCouldn't create output file \"%s\"\n", csvFilename);
+      return 1;
+    }
+    fprintf(csv, "class,order,adaptive,initial_temp,alpha,stages_length,"
+        "runs,success_rate,par_s,mean_final_cost\n");
+  }
+  printf("\n%-10s %5s %7s %11s %9s  %s\n", "class", "runs", "success",
+      "par(s)", "cost", "best configuration");
+  for (size_t k = 0; k < classes.size(); ++k) {
+    const InstanceClass& ic = classes[k];
+    const Config& c = configs[ic.alive[0]];
+    Score s = score(ic.runs[ic.alive[0]], base.maxSeconds);
+    char settings[96];
+    describe(c, ic.order, settings, sizeof(settings));
+    printf("%-10s %5d %6.1f%% %11.6f %9.2f  %s\n", ic.name.c_str(), s.runs,
+        100 * s.successRate, s.parSeconds, s.meanFinalCost, settings);
+    if (csv != NULL) {
+      SAParams p = paramsFor(c, ic.order, base);
+      fprintf(csv, "%s,%d,%d,%g,%.4f,%d,%d,%.4f,%.6f,%.4f\n", ic.name.c_str(),
+          ic.order, c.adaptive ? 1 : 0, p.initialTemp, p.alpha,
+          p.stagesLength, s.runs, s.successRate, s.parSeconds,
+          s.meanFinalCost);
+    }
+  }
+  if (csv != NULL) fclose(csv);
+  return 0;
+}
@@ -1,12 +1,9 @@
 #!/bin/bash
+# Runs the benchmark suite on the instances of etc/ and keeps the summary in
+# etc/out/. Extra arguments are passed to bench, e.g.:
+#   tests/scripts/run-tests.sh -seeds 20 -threads 4 -baseline etc/out/old.csv
+# (parseoutputs.py only reads the .info files of the former version of this
+# script.)
 
 mkdir -p etc/out/
-for i in {1..100}
-do
-    rs=$RANDOM
-    for file in etc/*_*
-    do
-        ./bin/sudoku "etc/out/$(basename "$file").rs=$rs.out" -rs $rs < $file > "etc/out/$(basename "$file").rs=$rs.info"
-    done
-done
-
+./bin/bench -dir etc -seeds 100 -csv etc/out/bench.csv -json etc/out/bench.json "$@"